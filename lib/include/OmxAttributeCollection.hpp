@@ -33,6 +33,8 @@ public:
 	OmxDataType getAttributeDataType(const std::string& name) const;
 	OmxIndex count() const;
 
+	void removeAttribute(const std::string& name);
+
     void setAttribute(const std::string& name, OmxInt8 *value);
     void setAttribute(const std::string& name, OmxUInt8 *value);
     void setAttribute(const std::string& name, OmxInt16 *value);
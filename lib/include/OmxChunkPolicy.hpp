@@ -0,0 +1,51 @@
+#ifndef OMXLIB_OMX_CHUNK_POLICY_HPP
+#define OMXLIB_OMX_CHUNK_POLICY_HPP
+
+#include "OmxPlatform.hpp"
+#include "OmxCommon.hpp"
+
+namespace omx {
+
+// Describes how the chunk shape of a new matrix is chosen.
+class OMXLib_API OmxChunkPolicy {
+public:
+	enum class Kind {
+		Default, RowStrip, SquareTile, Explicit, AccessPattern, Contiguous
+	};
+
+	// whole rows where they fit the ideal chunk size, otherwise pieces of a single row
+	static OmxChunkPolicy defaultPolicy();
+
+	// strips of whole rows, as many as fit the ideal chunk size (at least one)
+	static OmxChunkPolicy rowStrip();
+
+	// square tiles of about the ideal chunk size, or with the given side
+	static OmxChunkPolicy squareTile();
+	static OmxChunkPolicy squareTile(OmxIndex side);
+
+	static OmxChunkPolicy explicitDims(OmxIndex rows, OmxIndex columns);
+
+	static OmxChunkPolicy forAccessPattern(OmxAccessPattern accessPattern);
+
+	// no chunks: one contiguous, uncompressed block of storage that OmxMatrix::mapReadOnly() can map
+	static OmxChunkPolicy contiguous();
+
+	// overrides the ideal chunk size in bytes; 0 uses the library default for the compression level
+	OmxChunkPolicy withTargetChunkSize(size_t targetChunkSize) const;
+
+	Kind getKind() const;
+	OmxChunkDims getDims() const;
+	OmxAccessPattern getAccessPattern() const;
+	size_t getTargetChunkSize() const;
+
+private:
+	OmxChunkPolicy(Kind kind, OmxChunkDims dims, OmxAccessPattern accessPattern);
+
+	Kind _kind;
+	OmxChunkDims _dims;
+	OmxAccessPattern _accessPattern;
+	size_t _targetChunkSize;
+};
+
+}
+#endif
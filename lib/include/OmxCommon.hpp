@@ -44,5 +44,29 @@ enum class OMXLib_API OmxCompressionLevel {
 	NoCompression, Level_1, Level_2, Level_3, Level_4, Level_5, Level_6, Level_7, Level_8, Level_9
 };
 
+// compression applied with the level: deflate on its own, or a byte shuffle ahead of deflate, LZ4 or Zstd
+enum class OMXLib_API OmxCompressionCodec {
+	Deflate, ShuffleDeflate, ShuffleLZ4, ShuffleZstd
+};
+
+// LZ4 and Zstd are only available when OMXLib was built with them
+bool OMXLib_API isCompressionCodecAvailable(OmxCompressionCodec codec);
+
+// how a matrix is mostly read: whole rows in order, single rows anywhere, whole columns or rectangular blocks
+enum class OMXLib_API OmxAccessPattern {
+	Sequential, Random, Column, Block
+};
+
+// rows of several matrices in one buffer: one whole row after another, or the values of all matrices
+// for the first column, then for the second column, ...
+enum class OMXLib_API OmxRowLayout {
+	StructOfArrays, Interleaved
+};
+
+struct OmxChunkDims {
+	OmxIndex rows;
+	OmxIndex columns;
+};
+
 }
 #endif
\ No newline at end of file
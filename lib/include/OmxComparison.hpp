@@ -0,0 +1,69 @@
+#ifndef OMXLIB_OMX_COMPARISON_HPP
+#define OMXLIB_OMX_COMPARISON_HPP
+
+#include "OmxPlatform.hpp"
+#include "OmxCommon.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace omx {
+
+// Settings for OmxFile::compare() and OmxFile::compareMatrix(). Two values a and b match when
+// |a - b| <= absoluteTolerance + relativeTolerance * max(|a|, |b|), or when both are NaN.
+struct OMXLib_API OmxCompareOptions {
+	OmxCompareOptions();
+
+	double absoluteTolerance;
+	double relativeTolerance;
+
+	// stops comparing once a strip of chunk rows, or a matrix of a file, held a mismatch
+	bool stopAtFirstMismatch;
+
+	// how many of the largest differences are reported
+	size_t reportedDifferenceCount;
+
+	// defaults to all cores
+	uint32_t threadCount;
+};
+
+struct OmxCellDifference {
+	OmxIndex row;
+	OmxIndex col;
+	double value;
+	double otherValue;
+};
+
+struct OMXLib_API OmxMatrixComparison {
+	std::string name;
+	uint64_t mismatchCount;
+
+	// the root mean square difference covers the cells where both values are numbers,
+	// the largest absolute difference of a number against NaN is infinite
+	double rmse;
+	double maxDifference;
+
+	// mismatches by decreasing absolute difference
+	std::vector<OmxCellDifference> largestDifferences;
+
+	// chunk rows whose stored chunks were identical, so they were not decompressed
+	OmxIndex identicalChunkRows;
+
+	// false when the comparison stopped at the first mismatch
+	bool isComplete;
+};
+
+struct OMXLib_API OmxFileComparison {
+	std::vector<OmxMatrixComparison> matrices;
+	std::vector<std::string> onlyInFile;
+	std::vector<std::string> onlyInOther;
+
+	// false when the comparison stopped at the first mismatching matrix
+	bool isComplete;
+
+	bool isEqual() const;
+};
+
+}
+#endif
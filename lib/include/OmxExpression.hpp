@@ -0,0 +1,58 @@
+#ifndef OMXLIB_OMX_EXPRESSION_HPP
+#define OMXLIB_OMX_EXPRESSION_HPP
+
+#include "OmxPlatform.hpp"
+#include "OmxCommon.hpp"
+
+#include <memory>
+#include <string>
+
+namespace omx {
+
+class OmxExpressionProgram;
+
+// An elementwise formula over matrices, zonal references and scalars, evaluated in double precision
+// by OmxFile::evaluate(), e.g. matrix("auto") + matrix("transit") * rowReference("occupancy").
+class OMXLib_API OmxExpression {
+public:
+	friend OmxExpressionProgram;
+
+	enum class Op {
+		Matrix, Scalar, RowReference, ColumnReference, Negate, Add, Subtract, Multiply, Divide, Min, Max
+	};
+
+	OmxExpression(double value);
+
+	static OmxExpression matrix(const std::string& name);
+	static OmxExpression scalar(double value);
+
+	// a zonal reference indexed by the row (origin) or by the column (destination) of each cell
+	static OmxExpression rowReference(const std::string& name);
+	static OmxExpression columnReference(const std::string& name);
+
+	static OmxExpression min(const OmxExpression& left, const OmxExpression& right);
+	static OmxExpression max(const OmxExpression& left, const OmxExpression& right);
+
+	OmxExpression operator-() const;
+
+	friend OMXLib_API OmxExpression operator+(const OmxExpression& left, const OmxExpression& right);
+	friend OMXLib_API OmxExpression operator-(const OmxExpression& left, const OmxExpression& right);
+	friend OMXLib_API OmxExpression operator*(const OmxExpression& left, const OmxExpression& right);
+	friend OMXLib_API OmxExpression operator/(const OmxExpression& left, const OmxExpression& right);
+
+private:
+	struct Node;
+
+	OmxExpression(std::shared_ptr<const Node> node);
+	static OmxExpression binary(Op op, const OmxExpression& left, const OmxExpression& right);
+
+	std::shared_ptr<const Node> _node;
+};
+
+OMXLib_API OmxExpression operator+(const OmxExpression& left, const OmxExpression& right);
+OMXLib_API OmxExpression operator-(const OmxExpression& left, const OmxExpression& right);
+OMXLib_API OmxExpression operator*(const OmxExpression& left, const OmxExpression& right);
+OMXLib_API OmxExpression operator/(const OmxExpression& left, const OmxExpression& right);
+
+}
+#endif
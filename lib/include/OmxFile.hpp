@@ -4,10 +4,14 @@
 #include "OmxPlatform.hpp"
 #include "OmxCommon.hpp"
 #include "OmxAttributeCollection.hpp"
+#include "OmxChunkPolicy.hpp"
+#include "OmxExpression.hpp"
+#include "OmxComparison.hpp"
 
 #include <string>
 #include <vector>
 #include <memory>
+#include <future>
 
 namespace omx {
 
@@ -27,11 +31,29 @@ public:
 	void openWithTruncate(OmxIndex zones);
 	void openWithCreate(OmxIndex zones);
 
+	// in-memory files use the HDF5 core driver: openInMemory() starts an empty file that never touches
+	// disk, openIntoMemory() loads the existing file completely. Changes stay in memory until flushTo().
+	void openInMemory(OmxIndex zones);
+	void openIntoMemory();
+	bool isInMemory() const;
+
+	// writes the current state of the file to path
+	void flushTo(const std::string& path);
+
 	// misc methods
 	std::string getFilename() const;
 	OmxVersion getVersion() const;
 	OmxIndex getZones() const;
 	OmxCompressionLevel getDefaultCompressionLevel() const;
+	void setDefaultCompressionCodec(OmxCompressionCodec compressionCodec);
+	OmxCompressionCodec getDefaultCompressionCodec() const;
+	void setDefaultChunkPolicy(const OmxChunkPolicy& chunkPolicy);
+	OmxChunkPolicy getDefaultChunkPolicy() const;
+
+	// caps the memory of the HDF5 chunk caches of all matrices configured afterwards, 0 means no cap;
+	// while a cap is set every matrix is given an explicit share of it when opened
+	void setChunkCacheBudget(size_t bytes);
+	size_t getChunkCacheBudget() const;
 	size_t getSize() const;
 
 	// matrix methods
@@ -40,10 +62,78 @@ public:
 	OmxMatrix& addMatrix(const std::string& name);
 	OmxMatrix& addMatrix(const std::string& name, OmxDataType dataType);
 	OmxMatrix& addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel);
+	OmxMatrix& addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, const OmxChunkPolicy& chunkPolicy);
+	OmxMatrix& addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, OmxCompressionCodec compressionCodec);
+	OmxMatrix& addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, OmxCompressionCodec compressionCodec, const OmxChunkPolicy& chunkPolicy);
 	void removeMatrix(const std::string& name);
 	void removeMatrix(OmxIndex index);
 	std::vector<std::string> getMatrixNames() const; 
 
+	// Copies matrix name of other with its attributes to newName (default: the same name) of this file,
+	// which must have as many zones. The stored chunks are copied as they are with H5Ocopy, without being
+	// decompressed; copyMatricesFrom() copies several matrices under their own names.
+	void copyMatrixFrom(OmxFile& other, const std::string& name);
+	void copyMatrixFrom(OmxFile& other, const std::string& name, const std::string& newName);
+	void copyMatricesFrom(OmxFile& other, const std::vector<std::string>& names);
+
+	// Reads the same row from each of the named matrices into buffer, laid out as requested; interleaved
+	// rows need matrices of one data type. For compressed matrices the chunk rows holding the row are
+	// fetched together and the chunks of all of them decoded at once on all cores, the following rows of
+	// those chunk rows are then copied from memory. With prefetchNext (and a thread-safe HDF5) the following
+	// row of the same matrices is read in the background and handed out by the next call when nothing was
+	// written to them in between. The matrices must not be closed until that next call.
+	void readRows(OmxIndex row, const std::vector<std::string>& matrixNames, void *buffer, OmxRowLayout layout);
+	void readRows(OmxIndex row, const std::vector<std::string>& matrixNames, void *buffer, OmxRowLayout layout, bool prefetchNext);
+
+	// Queue reads and writes of the named matrices for the I/O thread of the file, which makes all of their
+	// HDF5 calls; any thread may queue them. Requests waiting together are issued ordered by matrix and row,
+	// and whole row reads of adjacent rows are merged into one block read. The futures are ready once the
+	// request completed and carry its exception if it failed. Buffers must stay valid until then, and while
+	// requests are outstanding the file and its matrices must not be used otherwise. waitForAsync() waits for
+	// all queued requests; close(), flushTo() and removing matrices wait as well.
+	std::future<void> readRowAsync(const std::string& matrixName, OmxIndex row, void *rowBuffer);
+	std::future<void> readBlockAsync(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer);
+	std::future<void> writeRowAsync(const std::string& matrixName, OmxIndex row, const void *rowBuffer);
+	std::future<void> writeBlockAsync(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer);
+	void waitForAsync();
+
+	// Evaluates expression for every cell and writes it to the matrix resultName, which is added with the
+	// file defaults when it doesn't exist. Matrices are streamed in strips of whole chunk rows without
+	// full matrix temporaries, the strips are computed on threadCount threads (default: all cores).
+	// Integer results take values beyond the range of their type as its smallest or largest value,
+	// infinities included, and NaN as 0.
+	void evaluate(const std::string& resultName, const OmxExpression& expression);
+	void evaluate(const std::string& resultName, const OmxExpression& expression, uint32_t threadCount);
+
+	// Writes the transpose of matrix sourceName to destName, which is added with the source data type and
+	// compression when it doesn't exist. Works out of core in bands of result rows and source tiles aligned
+	// to the chunk layouts, holding about memoryBudget bytes (default 256 MB) besides the HDF5 chunk cache.
+	void transposeMatrix(const std::string& sourceName, const std::string& destName);
+	void transposeMatrix(const std::string& sourceName, const std::string& destName, size_t memoryBudget);
+
+	// Sums matrix sourceName by the groups that the integer zonal reference mappingName assigns to the
+	// zones, numbered from 0; zones with a negative group are left out. Returns the groupCount x groupCount
+	// sums, row-major, where groupCount is one more than the largest group. The source is streamed once in
+	// strips of whole chunk rows and summed on all cores, each core taking whole groups of rows so that
+	// they share one accumulator of about groupCount x groupCount doubles. The second form writes the sums to matrix destName
+	// of dest (added as Double when it doesn't exist), which may be another, smaller file.
+	std::vector<double> aggregateMatrix(const std::string& sourceName, const std::string& mappingName);
+	void aggregateMatrix(const std::string& sourceName, const std::string& mappingName, OmxFile& dest, const std::string& destName);
+
+	// Writes the rows and columns of matrix sourceName at the given zone indices, in their order, to matrix
+	// destName of dest, which must have one zone per index; the matrix is added with the source data type
+	// and compression when it doesn't exist. Only source chunk rows holding selected rows are read.
+	void extractSubMatrix(const std::string& sourceName, const std::vector<OmxIndex>& zones, OmxFile& dest, const std::string& destName);
+
+	// Compares matrix name with matrix otherName of other cell by cell in double precision, streaming both
+	// in strips of whole chunk rows compared on options.threadCount threads. When both store their chunks
+	// alike, chunk rows whose stored chunks are byte for byte identical are skipped without decompressing.
+	OmxMatrixComparison compareMatrix(const std::string& name, OmxFile& other, const std::string& otherName, const OmxCompareOptions& options);
+
+	// compares the matrices of the same name in both files and lists those only one of them has
+	OmxFileComparison compare(OmxFile& other);
+	OmxFileComparison compare(OmxFile& other, const OmxCompareOptions& options);
+
 	OmxMatrix& getMatrix(OmxIndex index) const;
 	OmxMatrix& getMatrix(const std::string& name) const;
 	bool matrixNameExists(const std::string& name) const;
@@ -60,7 +150,12 @@ public:
 
 	OmxAttributeCollection& attributes() const;
 
-	void vacuum();
+	// Rewrites the file without the space left by removed matrices and zonal references, replaces the
+	// original with the compacted copy and returns the bytes reclaimed. Stored chunks are copied unchanged
+	// unless copyRawChunks is false, then matrices are decompressed and compressed again in parallel.
+	// Matrices and zonal references obtained before are no longer valid afterwards.
+	size_t vacuum();
+	size_t vacuum(bool copyRawChunks);
 
 	void close();
 
@@ -4,6 +4,7 @@
 #include "OmxPlatform.hpp"
 #include "OmxCommon.hpp"
 #include "OmxAttributeCollection.hpp"
+#include "OmxMatrixCursor.hpp"
 
 #include <memory>
 #include <string>
@@ -15,6 +16,28 @@ namespace omx {
 class OmxFile;
 struct OmxFileOwnerData;
 
+struct OmxMinMax {
+	double min;
+	double max;
+};
+
+struct OmxMatrixSummary {
+	std::vector<double> rowSums;
+	std::vector<double> columnSums;
+	double total;
+	double min;
+	double max;
+};
+
+// statistics of the stored values, NaN values are only counted
+struct OmxMatrixStats {
+	double sum;
+	double min;
+	double max;
+	uint64_t nonZeroCount;
+	uint64_t nanCount;
+};
+
 class OMXLib_API OmxMatrix {
 public:
 	friend OmxFile;
@@ -25,16 +48,89 @@ public:
 
 	std::string getName() const;
 
+	// rows may be held back until their chunk row is complete, close() writes any that remain
 	void writeRow(OmxIndex row, void *rowBuffer);
 	void writeRow(OmxIndex row, OmxIndex, void *rowBuffer, OmxDataType dataType);
 
 	void readRow(OmxIndex row, void *rowBuffer);	
 	void readRow(OmxIndex row, void *rowBuffer, OmxDataType dataType);
 
+	// blocks are row-major buffers of rowCount x colCount values
+	void readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer);
+	void writeBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer);
+
+	// columns are read chunk by chunk, or in strips of whole chunk rows when the matrix is mapped or its
+	// chunks are decoded on several threads; readColumns() fills buffer column after column, each
+	// holding getZones() values
+	void readColumn(OmxIndex col, void *columnBuffer);
+	void readColumns(const std::vector<OmxIndex>& cols, void *buffer);
+
+	// whole matrix transfers using a buffer from createMatrixBuffer(), optionally split
+	// across threads along chunk row boundaries
+	void readMatrix(void *buffer);
+	void readMatrix(void *buffer, uint32_t threadCount);
+	void writeMatrix(const void *buffer);
+	void writeMatrix(const void *buffer, uint32_t threadCount);
+
 	void* createMatrixRowBuffer() const;
+	void* createMatrixBlockBuffer(OmxIndex rowCount, OmxIndex colCount) const;
 	void* createMatrixBuffer() const;
 
+	// with more than one thread, writes of whole chunk rows to a compressed matrix are
+	// compressed in parallel and stored as finished chunks
+	void setCompressionThreads(uint32_t threadCount);
+	uint32_t getCompressionThreads() const;
+
+	// with more than one thread, reads of a compressed matrix fetch the stored chunks and
+	// decompress them in parallel; readRow() then decodes several chunk rows at a time
+	void setDecompressionThreads(uint32_t threadCount);
+	uint32_t getDecompressionThreads() const;
+
 	OmxCompressionLevel getCompressionLevel() const;
+	OmxCompressionCodec getCompressionCodec() const;
+
+	// sizes the HDF5 chunk cache of this matrix for the expected access, within the file's
+	// chunk cache budget; Random keeps the HDF5 default. Hints needing more than 256 MB or more than
+	// the budget get as many whole chunks as fit, getChunkCacheSize() reports the size in effect.
+	// The dataset is reopened to apply it: both setters first wait for a readRows() prefetch and the
+	// queued asynchronous requests of the file, and throw while cursors of the matrix are open.
+	void setAccessHint(OmxAccessPattern accessPattern);
+	OmxAccessPattern getAccessHint() const;
+
+	// an explicit chunk cache size in bytes, 0 returns to sizing by the access hint
+	void setChunkCacheSize(size_t bytes);
+	size_t getChunkCacheSize() const;
+
+	// for matrices created with OmxChunkPolicy::contiguous(): maps the stored values read only and returns
+	// the row-major zones x zones array, shared with every other process mapping the file. The pointer
+	// stays valid until unmap() or close(); while mapped, readRow() and readMatrix() copy from the mapping
+	// and writing the matrix throws, it has to be unmapped first.
+	const void* mapReadOnly();
+	void unmap();
+	bool isMapped() const;
+
+	// reductions over all cells, accumulated in double precision in a single pass over the stored
+	// chunk rows; summary() returns them all at once, on threadCount threads (default: all cores).
+	// rowSums() and columnSums() each make a full pass, so use summary() when more than one is needed;
+	// total() and minMax() use the stored statistics instead when hasStoredStats().
+	OmxMatrixSummary summary();
+	OmxMatrixSummary summary(uint32_t threadCount);
+	std::vector<double> rowSums();
+	std::vector<double> columnSums();
+	double total();
+	OmxMinMax minMax();
+
+	// statistics gathered while writing and stored as OMX_STATS_* attributes by close(), so they can be
+	// read without touching the data. They are only kept when every row was written whole exactly once
+	// since the matrix was added or opened; other writes remove previously stored statistics.
+	bool hasStoredStats() const;
+	OmxMatrixStats getStoredStats() const;
+
+	// a reader of this matrix for one thread; see OmxMatrixCursor for the threading model
+	OmxMatrixCursor openCursor();
+
+	// the stored chunk shape, reads and writes aligned to it touch the fewest chunks
+	OmxChunkDims getChunkDims() const;
 
 	OmxIndex getZones() const;
 	OmxDataType getDataType() const;
@@ -42,10 +138,33 @@ public:
 
 	OmxAttributeCollection& attributes() const;
 
+	// writes the rows still collected by writeRow() and the statistics; OmxFile::close() does so for
+	// every matrix and throws the first failure
 	void close();
 
 private:
 	OmxMatrix(OmxDataType dataType, OmxIndex zones, const std::string& name, OmxCompressionLevel compressionLevel, const OmxFileOwnerData *ownerData);
+
+	// for OmxFile::readRows(): a row with its values stride elements apart; background reads
+	// only go through HDF5 and leave pending rows alone
+	void readRowStrided(OmxIndex row, void *buffer, OmxIndex stride, bool isBackground);
+
+	// for OmxFile::readRows(): the chunk row holding row is fetched on the calling thread, its chunks
+	// (as many as returned, none when the row is at hand or can't be decoded directly) may be decoded
+	// on any threads, and finishChunkRow() makes the decoded rows available to readRowStrided()
+	OmxIndex fetchChunkRow(OmxIndex row);
+	void decodeFetchedChunk(OmxIndex index);
+	void finishChunkRow();
+	uint64_t getWriteGeneration() const;
+
+	// for OmxFile::removeMatrix(): drops collected rows and statistics and closes the dataset
+	void discard();
+
+	// for OmxFile::compareMatrix(): whether other stores chunks of the same shape, type and filters, and
+	// whether the stored chunks of a chunk row are byte for byte those of other
+	bool hasSameChunkStorage(const OmxMatrix& other) const;
+	bool isChunkRowStorageEqual(OmxMatrix& other, OmxIndex chunkRow);
+
 	class OmxMatrixImpl;
 	std::unique_ptr<OmxMatrixImpl> _impl;
 };
@@ -0,0 +1,49 @@
+#ifndef OMXLIB_OMX_MATRIX_CURSOR_HPP
+#define OMXLIB_OMX_MATRIX_CURSOR_HPP
+
+#include "OmxPlatform.hpp"
+#include "OmxCommon.hpp"
+
+#include <memory>
+
+namespace omx {
+class OmxMatrix;
+
+// Reads one matrix with its own HDF5 selections and its own decoded chunk row, so that several threads
+// can read the same open matrix at once.
+//
+// Threading model: OmxFile, OmxMatrix, OmxZonalReference and OmxAttributeCollection are not thread-safe,
+// each must be used by one thread at a time. To read a matrix from several threads, open one cursor per
+// thread with OmxMatrix::openCursor() and read through it. Compressed chunks are fetched under the HDF5
+// lock and decompressed on the reading thread, so cursors decompress in parallel; with an HDF5 built
+// without thread safety their HDF5 calls are serialized among each other. While cursors are in use the
+// matrix must not be written, unmapped or closed, and its file must stay open. Cursors share the dataset
+// handle of the matrix, so setAccessHint() and setChunkCacheSize() throw until they are destroyed.
+class OMXLib_API OmxMatrixCursor {
+public:
+	friend OmxMatrix;
+
+	OmxMatrixCursor(OmxMatrixCursor&& other);
+	OmxMatrixCursor & operator=(OmxMatrixCursor&& other);
+	OmxMatrixCursor(const OmxMatrixCursor&) = delete;
+	OmxMatrixCursor & operator=(const OmxMatrixCursor&) = delete;
+	~OmxMatrixCursor();
+
+	void readRow(OmxIndex row, void *rowBuffer);
+	void readRow(OmxIndex row, void *rowBuffer, OmxDataType dataType);
+
+	// blocks are row-major buffers of rowCount x colCount values
+	void readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer);
+
+	OmxIndex getZones() const;
+	OmxDataType getDataType() const;
+
+private:
+	class OmxMatrixCursorImpl;
+
+	OmxMatrixCursor(OmxMatrixCursorImpl *impl);
+
+	std::unique_ptr<OmxMatrixCursorImpl> _impl;
+};
+}
+#endif
@@ -150,7 +150,7 @@ public:
 	}
 
 	bool hasAttribute(const std::string& name) const {
-		htri_t status = H5Aexists(_handle, name.c_str());
+		htri_t status = H5Aexists_by_name(_handle, _path.c_str(), name.c_str(), H5P_DEFAULT);
 
 		if (status > 0) {
 			return true;
@@ -443,6 +443,10 @@ OmxDataType OmxAttributeCollection::getAttributeDataType(const std::string& name
 	return _impl->getAttributeDataType(name, &size);
 }
 
+void OmxAttributeCollection::removeAttribute(const std::string& name) {
+	_impl->removeAttribute(name);
+}
+
 bool OmxAttributeCollection::hasAttribute(const std::string& name) const {
 	return _impl->hasAttribute(name);
 }
@@ -0,0 +1,117 @@
+#include "OmxCellComparer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace omx {
+
+static double getDifference(const OmxCellDifference& difference) {
+	// a number against NaN is the largest difference there is
+	auto value = std::fabs(difference.value - difference.otherValue);
+	return value != value ? std::numeric_limits<double>::infinity() : value;
+}
+
+static bool isSmallerDifference(const OmxCellDifference& left, const OmxCellDifference& right) {
+	return getDifference(left) > getDifference(right);
+}
+
+OmxCellComparer::OmxCellComparer(const OmxCompareOptions& options)
+	: _absoluteTolerance( options.absoluteTolerance ), _relativeTolerance( options.relativeTolerance ),
+	_reportedDifferenceCount( options.reportedDifferenceCount ),
+	_mismatchCount( 0 ), _numberCount( 0 ), _sumOfSquares( 0.0 ), _maxDifference( 0.0 ) {
+}
+
+void OmxCellComparer::compare(OmxIndex row, OmxIndex col, size_t count, const double *values, const double *otherValues) {
+	// matching blocks, the common case, stay in a loop without branches
+	size_t mismatches = 0;
+	size_t numbers = 0;
+	double sumOfSquares = 0.0;
+	double maxDifference = _maxDifference;
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	for (size_t i = 0; i < count; i++) {
+		double a = values[i];
+		double b = otherValues[i];
+		// equal infinities have a NaN difference; no tolerance covers a difference with an infinity
+		double difference = a == b ? 0.0 : std::fabs(a - b);
+		double tolerance = _absoluteTolerance + _relativeTolerance * std::max(std::fabs(a), std::fabs(b));
+		bool isNumber = difference == difference;
+		bool isBothNaN = a != a && b != b;
+
+		mismatches += !(difference <= tolerance && difference < infinity) && !isBothNaN;
+		numbers += isNumber;
+		sumOfSquares += isNumber ? difference * difference : 0.0;
+
+		double cellDifference = isNumber ? difference : (isBothNaN ? 0.0 : infinity);
+		maxDifference = cellDifference > maxDifference ? cellDifference : maxDifference;
+	}
+
+	_numberCount += numbers;
+	_sumOfSquares += sumOfSquares;
+	_maxDifference = maxDifference;
+
+	if (mismatches == 0)
+		return;
+
+	_mismatchCount += mismatches;
+
+	for (size_t i = 0; i < count; i++) {
+		double a = values[i];
+		double b = otherValues[i];
+		double difference = a == b ? 0.0 : std::fabs(a - b);
+		double tolerance = _absoluteTolerance + _relativeTolerance * std::max(std::fabs(a), std::fabs(b));
+
+		if ((difference <= tolerance && difference < infinity) || (a != a && b != b))
+			continue;
+
+		addDifference(OmxCellDifference{ row, col + i, a, b });
+	}
+}
+
+void OmxCellComparer::addDifference(const OmxCellDifference& difference) {
+	if (_reportedDifferenceCount == 0)
+		return;
+
+	if (_largestDifferences.size() < _reportedDifferenceCount) {
+		_largestDifferences.push_back(difference);
+		std::push_heap(_largestDifferences.begin(), _largestDifferences.end(), isSmallerDifference);
+		return;
+	}
+
+	if (getDifference(difference) <= getDifference(_largestDifferences.front()))
+		return;
+
+	std::pop_heap(_largestDifferences.begin(), _largestDifferences.end(), isSmallerDifference);
+	_largestDifferences.back() = difference;
+	std::push_heap(_largestDifferences.begin(), _largestDifferences.end(), isSmallerDifference);
+}
+
+void OmxCellComparer::merge(const OmxCellComparer& other) {
+	_mismatchCount += other._mismatchCount;
+	_numberCount += other._numberCount;
+	_sumOfSquares += other._sumOfSquares;
+	_maxDifference = std::max(_maxDifference, other._maxDifference);
+
+	for (auto& difference : other._largestDifferences)
+		addDifference(difference);
+}
+
+void OmxCellComparer::report(OmxMatrixComparison *result) const {
+	result->mismatchCount = _mismatchCount;
+	result->rmse = _numberCount > 0 ? std::sqrt(_sumOfSquares / (double)_numberCount) : 0.0;
+	result->maxDifference = _maxDifference;
+
+	result->largestDifferences = _largestDifferences;
+	std::sort(result->largestDifferences.begin(), result->largestDifferences.end(), [](const OmxCellDifference& left, const OmxCellDifference& right) {
+		auto leftDifference = getDifference(left);
+		auto rightDifference = getDifference(right);
+
+		if (leftDifference != rightDifference)
+			return leftDifference > rightDifference;
+
+		return left.row < right.row || (left.row == right.row && left.col < right.col);
+	});
+}
+
+}
@@ -0,0 +1,43 @@
+#ifndef OMXLIB_OMX_CELL_COMPARER_HPP
+#define OMXLIB_OMX_CELL_COMPARER_HPP
+
+#include "../include/OmxComparison.hpp"
+
+#include <vector>
+
+namespace omx {
+
+// Compares blocks of values converted to double and keeps the totals and the largest differences.
+// Every thread uses its own comparer; they are merged afterwards.
+class OmxCellComparer {
+public:
+	OmxCellComparer(const OmxCompareOptions& options);
+
+	// compares count cells of row, starting at column col
+	void compare(OmxIndex row, OmxIndex col, size_t count, const double *values, const double *otherValues);
+
+	void merge(const OmxCellComparer& other);
+
+	uint64_t getMismatchCount() const { return _mismatchCount; }
+
+	// fills in the totals and the largest differences of result
+	void report(OmxMatrixComparison *result) const;
+
+private:
+	void addDifference(const OmxCellDifference& difference);
+
+	double _absoluteTolerance;
+	double _relativeTolerance;
+	size_t _reportedDifferenceCount;
+
+	uint64_t _mismatchCount;
+	uint64_t _numberCount;
+	double _sumOfSquares;
+	double _maxDifference;
+
+	// a min-heap on the absolute difference, so the smallest reported difference is replaced first
+	std::vector<OmxCellDifference> _largestDifferences;
+};
+
+}
+#endif
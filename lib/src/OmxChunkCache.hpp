@@ -0,0 +1,66 @@
+#ifndef OMXLIB_OMX_CHUNK_CACHE_HPP
+#define OMXLIB_OMX_CHUNK_CACHE_HPP
+
+#include <mutex>
+#include <algorithm>
+#include <cstddef>
+
+namespace omx {
+
+// File wide limit on the memory handed to the HDF5 chunk caches of its open matrices.
+struct OmxChunkCacheBudget {
+	OmxChunkCacheBudget() : _limit( 0 ), _used( 0 ) {
+	}
+
+	bool isLimited() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _limit > 0;
+	}
+
+	size_t getLimit() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _limit;
+	}
+
+	// returns how much of the requested size may be used, a limit of 0 grants everything
+	size_t reserve(size_t requested) {
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		size_t granted = requested;
+		if (_limit > 0)
+			granted = std::min(requested, _limit > _used ? _limit - _used : 0);
+
+		_used += granted;
+		return granted;
+	}
+
+	void release(size_t granted) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_used -= std::min(granted, _used);
+	}
+
+	std::mutex _mutex;
+	size_t _limit;
+	size_t _used;
+};
+
+// HDF5 suggests a prime number of hash slots about 100 times the number of chunks that fit the cache
+inline size_t getChunkCacheSlots(size_t cacheSize, size_t chunkSize) {
+	size_t slots = std::max<size_t>(521, 100 * (cacheSize / std::max<size_t>(chunkSize, 1)));
+
+	auto isPrime = [](size_t n) {
+		for (size_t d = 2; d * d <= n; d++) {
+			if (n % d == 0)
+				return false;
+		}
+		return true;
+	};
+
+	while (!isPrime(slots))
+		slots++;
+
+	return slots;
+}
+
+}
+#endif
@@ -0,0 +1,477 @@
+#include "OmxChunkCodec.hpp"
+
+#include "OmxH5Common.hpp"
+
+#include <cstring>
+#include <mutex>
+
+#include <zlib.h>
+
+#ifdef OMXLIB_WITH_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef OMXLIB_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace omx {
+
+// LZ4 chunks are split into blocks of at most this size, as in the reference HDF5 LZ4 plugin
+static const uint32_t DEFAULT_LZ4_BLOCK_SIZE = 1 << 30;
+
+static bool isLittleEndianHost() {
+	const uint16_t value = 1;
+	return *(const uint8_t *)&value == 1;
+}
+
+#ifdef OMXLIB_WITH_LZ4
+static void storeBigEndian(uint8_t *dest, uint64_t value, int byteCount) {
+	for (int i = byteCount - 1; i >= 0; i--) {
+		dest[i] = (uint8_t)(value & 0xff);
+		value >>= 8;
+	}
+}
+
+static uint64_t loadBigEndian(const uint8_t *src, int byteCount) {
+	uint64_t value = 0;
+	for (int i = 0; i < byteCount; i++)
+		value = (value << 8) | src[i];
+
+	return value;
+}
+#endif
+
+static bool isCompressorAvailable(OmxChunkCompressor compressor) {
+	switch (compressor) {
+#ifdef OMXLIB_WITH_LZ4
+	case OmxChunkCompressor::LZ4:		return true;
+#endif
+#ifdef OMXLIB_WITH_ZSTD
+	case OmxChunkCompressor::Zstd:		return true;
+#endif
+	case OmxChunkCompressor::None:
+	case OmxChunkCompressor::Deflate:	return true;
+	default:							return false;
+	}
+}
+
+// Block format of the reference plugin: the 8 byte original size and the 4 byte block size,
+// then per block its 4 byte compressed size and data. Blocks that don't shrink are stored raw.
+static size_t encodeLZ4(const uint8_t *data, size_t size, uint32_t blockSize, std::vector<uint8_t> *encoded) {
+#ifdef OMXLIB_WITH_LZ4
+	if (blockSize == 0 || blockSize > DEFAULT_LZ4_BLOCK_SIZE)
+		blockSize = DEFAULT_LZ4_BLOCK_SIZE;
+	if (blockSize > size)
+		blockSize = (uint32_t)size;
+
+	size_t blockCount = blockSize > 0 ? (size + blockSize - 1) / blockSize : 0;
+	encoded->resize(12 + blockCount * (4 + (size_t)LZ4_compressBound((int)blockSize)));
+
+	uint8_t *out = encoded->data();
+	storeBigEndian(out, size, 8);
+	storeBigEndian(out + 8, blockSize, 4);
+	out += 12;
+
+	for (size_t offset = 0; offset < size; offset += blockSize) {
+		int srcSize = (int)std::min<size_t>(blockSize, size - offset);
+		int dstSize = LZ4_compress_default((const char *)data + offset, (char *)out + 4, srcSize, LZ4_compressBound(srcSize));
+
+		if (dstSize <= 0)
+			throw OmxException("Unable to compress chunk.");
+
+		if (dstSize >= srcSize) {
+			std::memcpy(out + 4, data + offset, srcSize);
+			dstSize = srcSize;
+		}
+
+		storeBigEndian(out, (uint64_t)dstSize, 4);
+		out += 4 + dstSize;
+	}
+
+	return out - encoded->data();
+#else
+	throw OmxException("LZ4 compression is not available in this build.");
+#endif
+}
+
+static size_t decodeLZ4(const uint8_t *encoded, size_t encodedSize, uint8_t *data, size_t size) {
+#ifdef OMXLIB_WITH_LZ4
+	if (encodedSize < 12)
+		throw OmxException("Unable to decompress chunk.");
+
+	uint64_t originalSize = loadBigEndian(encoded, 8);
+	uint64_t blockSize = loadBigEndian(encoded + 8, 4);
+	if (originalSize > size || (originalSize > 0 && blockSize == 0))
+		throw OmxException("Unable to decompress chunk.");
+
+	const uint8_t *in = encoded + 12;
+	const uint8_t *end = encoded + encodedSize;
+
+	for (uint64_t offset = 0; offset < originalSize; offset += blockSize) {
+		int dstSize = (int)std::min<uint64_t>(blockSize, originalSize - offset);
+		if (end - in < 4)
+			throw OmxException("Unable to decompress chunk.");
+
+		int srcSize = (int)loadBigEndian(in, 4);
+		in += 4;
+		if (srcSize < 0 || end - in < srcSize)
+			throw OmxException("Unable to decompress chunk.");
+
+		if (srcSize == dstSize) {
+			std::memcpy(data + offset, in, srcSize);
+		}
+		else if (LZ4_decompress_safe((const char *)in, (char *)data + offset, srcSize, dstSize) != dstSize) {
+			throw OmxException("Unable to decompress chunk.");
+		}
+
+		in += srcSize;
+	}
+
+	return (size_t)originalSize;
+#else
+	throw OmxException("LZ4 compression is not available in this build.");
+#endif
+}
+
+static size_t encodeZstd(const uint8_t *data, size_t size, uint32_t level, std::vector<uint8_t> *encoded) {
+#ifdef OMXLIB_WITH_ZSTD
+	encoded->resize(ZSTD_compressBound(size));
+
+	size_t encodedSize = ZSTD_compress(encoded->data(), encoded->size(), data, size, (int)level);
+	if (ZSTD_isError(encodedSize))
+		throw OmxException("Unable to compress chunk.");
+
+	return encodedSize;
+#else
+	throw OmxException("Zstd compression is not available in this build.");
+#endif
+}
+
+static size_t decodeZstd(const uint8_t *encoded, size_t encodedSize, uint8_t *data, size_t size) {
+#ifdef OMXLIB_WITH_ZSTD
+	size_t decodedSize = ZSTD_decompress(data, size, encoded, encodedSize);
+	if (ZSTD_isError(decodedSize))
+		throw OmxException("Unable to decompress chunk.");
+
+	return decodedSize;
+#else
+	throw OmxException("Zstd compression is not available in this build.");
+#endif
+}
+
+// HDF5 filter callbacks for the LZ4 and Zstd filters. Buffers passed through the filter
+// pipeline belong to HDF5 and have to be swapped with H5allocate_memory/H5free_memory.
+template <size_t(*EncodeFn)(const uint8_t *, size_t, uint32_t, std::vector<uint8_t> *),
+		  size_t(*DecodeFn)(const uint8_t *, size_t, uint8_t *, size_t),
+		  size_t(*DecodedSizeFn)(const uint8_t *, size_t)>
+static size_t h5CompressionFilter(unsigned int flags, size_t valueCount, const unsigned int values[], size_t size, size_t *bufferSize, void **buffer) {
+	try {
+		std::vector<uint8_t> encoded;
+		const uint8_t *in = (const uint8_t *)*buffer;
+		size_t outSize;
+
+		void *out;
+		if (flags & H5Z_FLAG_REVERSE) {
+			outSize = DecodedSizeFn(in, size);
+			out = H5allocate_memory(outSize, false);
+			if (!out)
+				return 0;
+
+			if (DecodeFn(in, size, (uint8_t *)out, outSize) != outSize) {
+				H5free_memory(out);
+				return 0;
+			}
+		}
+		else {
+			outSize = EncodeFn(in, size, valueCount > 0 ? values[0] : 0, &encoded);
+			out = H5allocate_memory(outSize, false);
+			if (!out)
+				return 0;
+
+			std::memcpy(out, encoded.data(), outSize);
+		}
+
+		H5free_memory(*buffer);
+		*buffer = out;
+		*bufferSize = outSize;
+		return outSize;
+	}
+	catch (...) {
+		return 0;
+	}
+}
+
+#ifdef OMXLIB_WITH_LZ4
+static size_t getLZ4DecodedSize(const uint8_t *encoded, size_t encodedSize) {
+	if (encodedSize < 12)
+		throw OmxException("Unable to decompress chunk.");
+
+	return (size_t)loadBigEndian(encoded, 8);
+}
+#endif
+
+#ifdef OMXLIB_WITH_ZSTD
+static size_t getZstdDecodedSize(const uint8_t *encoded, size_t encodedSize) {
+	auto decodedSize = ZSTD_getFrameContentSize(encoded, encodedSize);
+	if (decodedSize == ZSTD_CONTENTSIZE_ERROR || decodedSize == ZSTD_CONTENTSIZE_UNKNOWN)
+		throw OmxException("Unable to decompress chunk.");
+
+	return (size_t)decodedSize;
+}
+#endif
+
+void registerCompressionFilters() {
+	static std::once_flag registered;
+
+	std::call_once(registered, []() {
+#ifdef OMXLIB_WITH_LZ4
+		static const H5Z_class2_t lz4Filter = { H5Z_CLASS_T_VERS, H5Z_FILTER_OMX_LZ4, 1, 1, "lz4", NULL, NULL,
+			(H5Z_func_t)&h5CompressionFilter<encodeLZ4, decodeLZ4, getLZ4DecodedSize> };
+
+		if (H5Zfilter_avail(H5Z_FILTER_OMX_LZ4) <= 0)
+			H5Zregister(&lz4Filter);
+#endif
+#ifdef OMXLIB_WITH_ZSTD
+		static const H5Z_class2_t zstdFilter = { H5Z_CLASS_T_VERS, H5Z_FILTER_OMX_ZSTD, 1, 1, "zstd", NULL, NULL,
+			(H5Z_func_t)&h5CompressionFilter<encodeZstd, decodeZstd, getZstdDecodedSize> };
+
+		if (H5Zfilter_avail(H5Z_FILTER_OMX_ZSTD) <= 0)
+			H5Zregister(&zstdFilter);
+#endif
+	});
+}
+
+bool isCompressionCodecAvailable(OmxCompressionCodec codec) {
+	switch (codec) {
+	case OmxCompressionCodec::Deflate:
+	case OmxCompressionCodec::ShuffleDeflate:	return true;
+	case OmxCompressionCodec::ShuffleLZ4:		return isCompressorAvailable(OmxChunkCompressor::LZ4);
+	case OmxCompressionCodec::ShuffleZstd:		return isCompressorAvailable(OmxChunkCompressor::Zstd);
+	}
+
+	return false;
+}
+
+bool setH5CompressionFilters(hid_t datasetCreatePlist, OmxCompressionCodec codec, OmxCompressionLevel compressionLevel) {
+	if (compressionLevel == OmxCompressionLevel::NoCompression)
+		return true;
+
+	if (!isCompressionCodecAvailable(codec))
+		return false;
+
+	registerCompressionFilters();
+
+	// the shuffle filter takes its element size from the dataset type
+	if (codec != OmxCompressionCodec::Deflate && H5Pset_shuffle(datasetCreatePlist) < 0)
+		return false;
+
+	unsigned int level = getH5CompressionLevelFromOmx(compressionLevel);
+	herr_t status = -1;
+
+	switch (codec) {
+	case OmxCompressionCodec::Deflate:
+	case OmxCompressionCodec::ShuffleDeflate: {
+		status = H5Pset_deflate(datasetCreatePlist, level);
+		break;
+	}
+	case OmxCompressionCodec::ShuffleLZ4: {
+		// the level doesn't change the LZ4 encoding, it is only kept to be reported back
+		const unsigned int values[2] = { 0, level };
+		status = H5Pset_filter(datasetCreatePlist, H5Z_FILTER_OMX_LZ4, H5Z_FLAG_MANDATORY, 2, values);
+		break;
+	}
+	case OmxCompressionCodec::ShuffleZstd: {
+		status = H5Pset_filter(datasetCreatePlist, H5Z_FILTER_OMX_ZSTD, H5Z_FLAG_MANDATORY, 1, &level);
+		break;
+	}
+	}
+
+	return status >= 0;
+}
+
+OmxChunkFilters getChunkFilters(hid_t datasetCreatePlist) {
+	OmxChunkFilters filters{ true, OmxChunkCompressor::None, 0, -1, 0, -1 };
+
+	// chunks that were never written are filled with zeros, so fill values must be the default
+	H5D_fill_value_t fillValueStatus;
+	if (H5Pfill_value_defined(datasetCreatePlist, &fillValueStatus) < 0 || fillValueStatus == H5D_FILL_VALUE_USER_DEFINED) {
+		filters.isSupported = false;
+		return filters;
+	}
+
+	int filterCount = H5Pget_nfilters(datasetCreatePlist);
+	if (filterCount < 0) {
+		filters.isSupported = false;
+		return filters;
+	}
+
+	for (int i = 0; i < filterCount; i++) {
+		unsigned int flags, config;
+		unsigned int values[8];
+		size_t valueCount = 8;
+		char name[64];
+
+		auto filter = H5Pget_filter2(datasetCreatePlist, (unsigned)i, &flags, &valueCount, values, sizeof(name), name, &config);
+
+		// at most a shuffle followed by one compressor
+		bool isFirstCompressor = filters.compressor == OmxChunkCompressor::None;
+
+		if (filter == H5Z_FILTER_SHUFFLE && valueCount > 0 && filters.shuffleSize == 0 && isFirstCompressor) {
+			filters.shuffleSize = values[0];
+			filters.shufflePosition = i;
+		}
+		else if (filter == H5Z_FILTER_DEFLATE && valueCount > 0 && isFirstCompressor) {
+			filters.compressor = OmxChunkCompressor::Deflate;
+			filters.level = values[0];
+			filters.compressorPosition = i;
+		}
+		else if (filter == H5Z_FILTER_OMX_LZ4 && isFirstCompressor) {
+			filters.compressor = OmxChunkCompressor::LZ4;
+			filters.level = valueCount > 1 ? values[1] : 1;
+			filters.compressorPosition = i;
+		}
+		else if (filter == H5Z_FILTER_OMX_ZSTD && isFirstCompressor) {
+			filters.compressor = OmxChunkCompressor::Zstd;
+			filters.level = valueCount > 0 ? values[0] : 1;
+			filters.compressorPosition = i;
+		}
+		else {
+			filters.isSupported = false;
+		}
+	}
+
+	if (!isCompressorAvailable(filters.compressor))
+		filters.isSupported = false;
+
+	return filters;
+}
+
+OmxCompressionCodec getChunkCompressionCodec(const OmxChunkFilters& filters) {
+	switch (filters.compressor) {
+	case OmxChunkCompressor::LZ4:	return OmxCompressionCodec::ShuffleLZ4;
+	case OmxChunkCompressor::Zstd:	return OmxCompressionCodec::ShuffleZstd;
+	default:						return filters.shuffleSize > 0 ? OmxCompressionCodec::ShuffleDeflate : OmxCompressionCodec::Deflate;
+	}
+}
+
+bool canCodeChunksDirectly(const OmxChunkFilters& filters) {
+	return filters.isSupported && isLittleEndianHost();
+}
+
+// same byte order as the HDF5 shuffle filter: all first bytes of each element, then all second bytes, ...
+// trailing bytes that don't make a whole element stay where they are
+static void shuffle(const uint8_t *src, uint8_t *dest, size_t size, size_t elementSize) {
+	size_t elementCount = size / elementSize;
+
+	for (size_t b = 0; b < elementSize; b++) {
+		uint8_t *out = dest + b * elementCount;
+		for (size_t e = 0; e < elementCount; e++)
+			out[e] = src[e * elementSize + b];
+	}
+
+	std::memcpy(dest + elementCount * elementSize, src + elementCount * elementSize, size - elementCount * elementSize);
+}
+
+static void unshuffle(const uint8_t *src, uint8_t *dest, size_t size, size_t elementSize) {
+	size_t elementCount = size / elementSize;
+
+	for (size_t b = 0; b < elementSize; b++) {
+		const uint8_t *in = src + b * elementCount;
+		for (size_t e = 0; e < elementCount; e++)
+			dest[e * elementSize + b] = in[e];
+	}
+
+	std::memcpy(dest + elementCount * elementSize, src + elementCount * elementSize, size - elementCount * elementSize);
+}
+
+void encodeChunk(const OmxChunkFilters& filters, const uint8_t *data, size_t size, std::vector<uint8_t> *encoded) {
+	std::vector<uint8_t> shuffled;
+	if (filters.shuffleSize > 1) {
+		shuffled.resize(size);
+		shuffle(data, shuffled.data(), size, filters.shuffleSize);
+		data = shuffled.data();
+	}
+
+	size_t encodedSize = size;
+
+	switch (filters.compressor) {
+	case OmxChunkCompressor::None: {
+		encoded->assign(data, data + size);
+		break;
+	}
+	case OmxChunkCompressor::Deflate: {
+		// the HDF5 deflate filter stores zlib streams, as produced by compress2()
+		uLongf deflatedSize = compressBound((uLong)size);
+		encoded->resize(deflatedSize);
+
+		if (compress2(encoded->data(), &deflatedSize, data, (uLong)size, (int)filters.level) != Z_OK)
+			throw OmxException("Unable to compress chunk.");
+
+		encodedSize = deflatedSize;
+		break;
+	}
+	case OmxChunkCompressor::LZ4: {
+		encodedSize = encodeLZ4(data, size, 0, encoded);
+		break;
+	}
+	case OmxChunkCompressor::Zstd: {
+		encodedSize = encodeZstd(data, size, filters.level, encoded);
+		break;
+	}
+	}
+
+	encoded->resize(encodedSize);
+}
+
+void decodeChunk(const OmxChunkFilters& filters, uint32_t filterMask, const uint8_t *encoded, size_t encodedSize, uint8_t *data, size_t size) {
+	// bit i of the mask is set when HDF5 skipped the (optional) filter at position i for this chunk
+	bool isCompressed = filters.isCompressed() && !(filterMask & (1u << filters.compressorPosition));
+	bool isShuffled = filters.shuffleSize > 1 && !(filterMask & (1u << filters.shufflePosition));
+
+	std::vector<uint8_t> shuffled;
+	uint8_t *decoded = data;
+	if (isShuffled) {
+		shuffled.resize(size);
+		decoded = shuffled.data();
+	}
+
+	if (!isCompressed) {
+		if (encodedSize != size)
+			throw OmxException("Unexpected size of stored chunk.");
+
+		std::memcpy(decoded, encoded, size);
+	}
+	else {
+		size_t decodedSize = 0;
+
+		switch (filters.compressor) {
+		case OmxChunkCompressor::Deflate: {
+			uLongf deflatedSize = (uLongf)size;
+			if (uncompress(decoded, &deflatedSize, encoded, (uLong)encodedSize) != Z_OK)
+				throw OmxException("Unable to decompress chunk.");
+
+			decodedSize = deflatedSize;
+			break;
+		}
+		case OmxChunkCompressor::LZ4: {
+			decodedSize = decodeLZ4(encoded, encodedSize, decoded, size);
+			break;
+		}
+		case OmxChunkCompressor::Zstd: {
+			decodedSize = decodeZstd(encoded, encodedSize, decoded, size);
+			break;
+		}
+		case OmxChunkCompressor::None:
+			break;
+		}
+
+		if (decodedSize != size)
+			throw OmxException("Unable to decompress chunk.");
+	}
+
+	if (isShuffled)
+		unshuffle(decoded, data, size, filters.shuffleSize);
+}
+
+}
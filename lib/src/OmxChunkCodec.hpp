@@ -0,0 +1,56 @@
+#ifndef OMXLIB_OMX_CHUNK_CODEC_HPP
+#define OMXLIB_OMX_CHUNK_CODEC_HPP
+
+#include "../include/OmxCommon.hpp"
+
+#include <vector>
+#include <cstdint>
+
+#include <hdf5.h>
+
+namespace omx {
+
+// registered HDF5 filter ids
+static const H5Z_filter_t H5Z_FILTER_OMX_LZ4 = 32004;
+static const H5Z_filter_t H5Z_FILTER_OMX_ZSTD = 32015;
+
+enum class OmxChunkCompressor {
+	None, Deflate, LZ4, Zstd
+};
+
+// The filter pipeline of a chunked dataset, as far as OMXLib can run it outside of HDF5.
+// Chunks of datasets with a supported pipeline can be moved with H5Dwrite_chunk/H5Dread_chunk
+// and encoded or decoded on any thread.
+struct OmxChunkFilters {
+	bool isSupported;
+	OmxChunkCompressor compressor;
+	uint32_t level;
+	int compressorPosition;
+
+	// element size the values were shuffled by, 0 when not shuffled
+	size_t shuffleSize;
+	int shufflePosition;
+
+	inline bool isCompressed() const { return compressor != OmxChunkCompressor::None; }
+};
+
+OmxChunkFilters getChunkFilters(hid_t datasetCreatePlist);
+
+OmxCompressionCodec getChunkCompressionCodec(const OmxChunkFilters& filters);
+
+// adds the shuffle and compression filters for codec to a dataset creation plist, false if HDF5 refused them
+bool setH5CompressionFilters(hid_t datasetCreatePlist, OmxCompressionCodec codec, OmxCompressionLevel compressionLevel);
+
+// registers the LZ4 and Zstd filters built into OMXLib with HDF5
+void registerCompressionFilters();
+
+// chunk bytes are handed to HDF5 unconverted, which only matches the little endian file types on little endian hosts
+bool canCodeChunksDirectly(const OmxChunkFilters& filters);
+
+void encodeChunk(const OmxChunkFilters& filters, const uint8_t *data, size_t size, std::vector<uint8_t> *encoded);
+
+// filterMask is the mask HDF5 stored with the chunk, size is the size of the unfiltered chunk
+void decodeChunk(const OmxChunkFilters& filters, uint32_t filterMask, const uint8_t *encoded, size_t encodedSize, uint8_t *data, size_t size);
+
+}
+#endif
@@ -0,0 +1,65 @@
+#include "../include/OmxChunkPolicy.hpp"
+
+namespace omx {
+
+OmxChunkPolicy::OmxChunkPolicy(Kind kind, OmxChunkDims dims, OmxAccessPattern accessPattern)
+	: _kind( kind ), _dims( dims ), _accessPattern( accessPattern ), _targetChunkSize( 0 ) {
+}
+
+OmxChunkPolicy OmxChunkPolicy::defaultPolicy() {
+	return OmxChunkPolicy(Kind::Default, OmxChunkDims{ 0, 0 }, OmxAccessPattern::Sequential);
+}
+
+OmxChunkPolicy OmxChunkPolicy::rowStrip() {
+	return OmxChunkPolicy(Kind::RowStrip, OmxChunkDims{ 0, 0 }, OmxAccessPattern::Sequential);
+}
+
+OmxChunkPolicy OmxChunkPolicy::squareTile() {
+	return OmxChunkPolicy(Kind::SquareTile, OmxChunkDims{ 0, 0 }, OmxAccessPattern::Block);
+}
+
+OmxChunkPolicy OmxChunkPolicy::squareTile(OmxIndex side) {
+	if (side == 0)
+		throw OmxException("Chunk tiles must have at least one row and column.");
+
+	return OmxChunkPolicy(Kind::SquareTile, OmxChunkDims{ side, side }, OmxAccessPattern::Block);
+}
+
+OmxChunkPolicy OmxChunkPolicy::explicitDims(OmxIndex rows, OmxIndex columns) {
+	if (rows == 0 || columns == 0)
+		throw OmxException("Chunks must have at least one row and column.");
+
+	return OmxChunkPolicy(Kind::Explicit, OmxChunkDims{ rows, columns }, OmxAccessPattern::Block);
+}
+
+OmxChunkPolicy OmxChunkPolicy::forAccessPattern(OmxAccessPattern accessPattern) {
+	return OmxChunkPolicy(Kind::AccessPattern, OmxChunkDims{ 0, 0 }, accessPattern);
+}
+
+OmxChunkPolicy OmxChunkPolicy::contiguous() {
+	return OmxChunkPolicy(Kind::Contiguous, OmxChunkDims{ 0, 0 }, OmxAccessPattern::Sequential);
+}
+
+OmxChunkPolicy OmxChunkPolicy::withTargetChunkSize(size_t targetChunkSize) const {
+	OmxChunkPolicy policy(*this);
+	policy._targetChunkSize = targetChunkSize;
+	return policy;
+}
+
+OmxChunkPolicy::Kind OmxChunkPolicy::getKind() const {
+	return _kind;
+}
+
+OmxChunkDims OmxChunkPolicy::getDims() const {
+	return _dims;
+}
+
+OmxAccessPattern OmxChunkPolicy::getAccessPattern() const {
+	return _accessPattern;
+}
+
+size_t OmxChunkPolicy::getTargetChunkSize() const {
+	return _targetChunkSize;
+}
+
+}
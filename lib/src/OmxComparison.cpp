@@ -0,0 +1,25 @@
+#include "../include/OmxComparison.hpp"
+
+#include <thread>
+#include <algorithm>
+
+namespace omx {
+
+OmxCompareOptions::OmxCompareOptions()
+	: absoluteTolerance( 0.0 ), relativeTolerance( 0.0 ), stopAtFirstMismatch( false ), reportedDifferenceCount( 10 ),
+	threadCount( std::max<uint32_t>(std::thread::hardware_concurrency(), 1) ) {
+}
+
+bool OmxFileComparison::isEqual() const {
+	if (!isComplete || !onlyInFile.empty() || !onlyInOther.empty())
+		return false;
+
+	for (auto& matrix : matrices) {
+		if (matrix.mismatchCount > 0)
+			return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef OMXLIB_OMX_DATA_CONVERSION_HPP
+#define OMXLIB_OMX_DATA_CONVERSION_HPP
+
+#include "../include/OmxCommon.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+namespace omx {
+
+// calls fn with a null pointer of the value type stored for dataType, so generic code
+// can be instantiated once per numeric OmxDataType
+template <typename Fn>
+void withValueType(OmxDataType dataType, Fn&& fn) {
+	switch (dataType) {
+	case OmxDataType::Int8:		fn((OmxInt8 *)nullptr); break;
+	case OmxDataType::UInt8:	fn((OmxUInt8 *)nullptr); break;
+	case OmxDataType::Int16:	fn((OmxInt16 *)nullptr); break;
+	case OmxDataType::UInt16:	fn((OmxUInt16 *)nullptr); break;
+	case OmxDataType::Int32:	fn((OmxInt32 *)nullptr); break;
+	case OmxDataType::UInt32:	fn((OmxUInt32 *)nullptr); break;
+	case OmxDataType::Int64:	fn((OmxInt64 *)nullptr); break;
+	case OmxDataType::UInt64:	fn((OmxUInt64 *)nullptr); break;
+	case OmxDataType::Float:	fn((OmxFloat *)nullptr); break;
+	case OmxDataType::Double:	fn((OmxDouble *)nullptr); break;
+	default:					throw OmxException("Only numeric data types are supported.");
+	}
+}
+
+// calls fn with a null pointer of an unsigned type of valueSize bytes, for code that only moves values
+template <typename Fn>
+void withValueSize(size_t valueSize, Fn&& fn) {
+	switch (valueSize) {
+	case 1:		fn((uint8_t *)nullptr); break;
+	case 2:		fn((uint16_t *)nullptr); break;
+	case 4:		fn((uint32_t *)nullptr); break;
+	case 8:		fn((uint64_t *)nullptr); break;
+	default:	throw OmxException("Unsupported value size " + std::to_string(valueSize) + ".");
+	}
+}
+
+// plain loops over one type each, which the compiler vectorizes
+template <typename T>
+void convertToDouble(const T *src, size_t count, double *dest) {
+	for (size_t i = 0; i < count; i++)
+		dest[i] = (double)src[i];
+}
+
+// integer types take values beyond their range as their smallest or largest value and NaN as 0,
+// a plain cast of those is undefined
+template <typename T>
+inline T fromDouble(double value, std::true_type) {
+	if (value != value)
+		return 0;
+	if (value <= (double)std::numeric_limits<T>::lowest())
+		return std::numeric_limits<T>::lowest();
+	if (value >= (double)std::numeric_limits<T>::max())
+		return std::numeric_limits<T>::max();
+
+	return (T)value;
+}
+
+template <typename T>
+inline T fromDouble(double value, std::false_type) {
+	return (T)value;
+}
+
+template <typename T>
+void convertFromDouble(const double *src, size_t count, T *dest) {
+	for (size_t i = 0; i < count; i++)
+		dest[i] = fromDouble<T>(src[i], std::is_integral<T>());
+}
+
+inline void convertToDouble(OmxDataType dataType, const void *src, size_t count, double *dest) {
+	withValueType(dataType, [&](auto type) {
+		convertToDouble((const std::remove_pointer_t<decltype(type)> *)src, count, dest);
+	});
+}
+
+inline void convertFromDouble(OmxDataType dataType, const double *src, size_t count, void *dest) {
+	withValueType(dataType, [&](auto type) {
+		convertFromDouble(src, count, (std::remove_pointer_t<decltype(type)> *)dest);
+	});
+}
+
+}
+#endif
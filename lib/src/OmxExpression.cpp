@@ -0,0 +1,61 @@
+#include "../include/OmxExpression.hpp"
+
+#include "OmxExpressionProgram.hpp"
+
+namespace omx {
+
+OmxExpression::OmxExpression(std::shared_ptr<const Node> node) : _node( node ) {
+}
+
+OmxExpression::OmxExpression(double value) : OmxExpression(scalar(value)) {
+}
+
+OmxExpression OmxExpression::matrix(const std::string& name) {
+	return OmxExpression(std::make_shared<const Node>(Node{ Op::Matrix, 0.0, name, nullptr, nullptr }));
+}
+
+OmxExpression OmxExpression::scalar(double value) {
+	return OmxExpression(std::make_shared<const Node>(Node{ Op::Scalar, value, std::string(), nullptr, nullptr }));
+}
+
+OmxExpression OmxExpression::rowReference(const std::string& name) {
+	return OmxExpression(std::make_shared<const Node>(Node{ Op::RowReference, 0.0, name, nullptr, nullptr }));
+}
+
+OmxExpression OmxExpression::columnReference(const std::string& name) {
+	return OmxExpression(std::make_shared<const Node>(Node{ Op::ColumnReference, 0.0, name, nullptr, nullptr }));
+}
+
+OmxExpression OmxExpression::binary(Op op, const OmxExpression& left, const OmxExpression& right) {
+	return OmxExpression(std::make_shared<const Node>(Node{ op, 0.0, std::string(), left._node, right._node }));
+}
+
+OmxExpression OmxExpression::min(const OmxExpression& left, const OmxExpression& right) {
+	return binary(Op::Min, left, right);
+}
+
+OmxExpression OmxExpression::max(const OmxExpression& left, const OmxExpression& right) {
+	return binary(Op::Max, left, right);
+}
+
+OmxExpression OmxExpression::operator-() const {
+	return OmxExpression(std::make_shared<const Node>(Node{ Op::Negate, 0.0, std::string(), _node, nullptr }));
+}
+
+OmxExpression operator+(const OmxExpression& left, const OmxExpression& right) {
+	return OmxExpression::binary(OmxExpression::Op::Add, left, right);
+}
+
+OmxExpression operator-(const OmxExpression& left, const OmxExpression& right) {
+	return OmxExpression::binary(OmxExpression::Op::Subtract, left, right);
+}
+
+OmxExpression operator*(const OmxExpression& left, const OmxExpression& right) {
+	return OmxExpression::binary(OmxExpression::Op::Multiply, left, right);
+}
+
+OmxExpression operator/(const OmxExpression& left, const OmxExpression& right) {
+	return OmxExpression::binary(OmxExpression::Op::Divide, left, right);
+}
+
+}
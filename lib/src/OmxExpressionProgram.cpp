@@ -0,0 +1,133 @@
+#include "OmxExpressionProgram.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace omx {
+
+OmxExpressionProgram::OmxExpressionProgram(const OmxExpression& expression) : _stackDepth( 0 ) {
+	_stackDepth = compile(*expression._node);
+}
+
+size_t OmxExpressionProgram::getIndex(std::vector<std::string> *names, const std::string& name) {
+	auto it = std::find(names->begin(), names->end(), name);
+	if (it != names->end())
+		return it - names->begin();
+
+	names->push_back(name);
+	return names->size() - 1;
+}
+
+// returns the stack depth the node needs
+size_t OmxExpressionProgram::compile(const OmxExpression::Node& node) {
+	switch (node._op) {
+	case OmxExpression::Op::Matrix:
+		_instructions.push_back(Instruction{ node._op, getIndex(&_matrixNames, node._name), 0.0 });
+		return 1;
+
+	case OmxExpression::Op::RowReference:
+	case OmxExpression::Op::ColumnReference:
+		_instructions.push_back(Instruction{ node._op, getIndex(&_referenceNames, node._name), 0.0 });
+		return 1;
+
+	case OmxExpression::Op::Scalar:
+		_instructions.push_back(Instruction{ node._op, 0, node._value });
+		return 1;
+
+	case OmxExpression::Op::Negate: {
+		auto depth = compile(*node._left);
+		_instructions.push_back(Instruction{ node._op, 0, 0.0 });
+		return depth;
+	}
+
+	default: {
+		auto leftDepth = compile(*node._left);
+		auto rightDepth = compile(*node._right);
+		_instructions.push_back(Instruction{ node._op, 0, 0.0 });
+		return std::max(leftDepth, rightDepth + 1);
+	}
+	}
+}
+
+// The operators run over whole blocks whatever the count: with a fixed trip count and slots that
+// don't alias, the compiler vectorizes the loops at -O2 without runtime checks or a scalar tail. The
+// values past count are left from earlier blocks and never read back.
+template <typename Fn>
+static void applyBinary(double * __restrict left, const double * __restrict right, Fn fn) {
+	for (size_t i = 0; i < OmxExpressionProgram::BLOCK_SIZE; i++)
+		left[i] = fn(left[i], right[i]);
+}
+
+static void applyNegate(double * __restrict values) {
+	for (size_t i = 0; i < OmxExpressionProgram::BLOCK_SIZE; i++)
+		values[i] = -values[i];
+}
+
+void OmxExpressionProgram::evaluate(OmxIndex row, OmxIndex col, size_t count, const double * const *matrixValues,
+	const double * const *references, double *stack) const {
+	size_t top = 0;
+
+	for (auto& instruction : _instructions) {
+		double *slot = stack + top * BLOCK_SIZE;
+		double *left = slot - 2 * BLOCK_SIZE;
+		double *right = slot - BLOCK_SIZE;
+
+		switch (instruction._op) {
+		case OmxExpression::Op::Matrix:
+			std::memcpy(slot, matrixValues[instruction._index], count * sizeof(double));
+			top++;
+			break;
+
+		case OmxExpression::Op::Scalar:
+			std::fill(slot, slot + count, instruction._value);
+			top++;
+			break;
+
+		case OmxExpression::Op::RowReference:
+			std::fill(slot, slot + count, references[instruction._index][row]);
+			top++;
+			break;
+
+		case OmxExpression::Op::ColumnReference:
+			std::memcpy(slot, references[instruction._index] + col, count * sizeof(double));
+			top++;
+			break;
+
+		case OmxExpression::Op::Negate:
+			applyNegate(right);
+			break;
+
+		case OmxExpression::Op::Add:
+			applyBinary(left, right, [](double a, double b) { return a + b; });
+			top--;
+			break;
+
+		case OmxExpression::Op::Subtract:
+			applyBinary(left, right, [](double a, double b) { return a - b; });
+			top--;
+			break;
+
+		case OmxExpression::Op::Multiply:
+			applyBinary(left, right, [](double a, double b) { return a * b; });
+			top--;
+			break;
+
+		case OmxExpression::Op::Divide:
+			applyBinary(left, right, [](double a, double b) { return a / b; });
+			top--;
+			break;
+
+		case OmxExpression::Op::Min:
+			applyBinary(left, right, [](double a, double b) { return b < a ? b : a; });
+			top--;
+			break;
+
+		case OmxExpression::Op::Max:
+			applyBinary(left, right, [](double a, double b) { return b > a ? b : a; });
+			top--;
+			break;
+		}
+	}
+}
+
+}
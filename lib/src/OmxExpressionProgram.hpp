@@ -0,0 +1,56 @@
+#ifndef OMXLIB_OMX_EXPRESSION_PROGRAM_HPP
+#define OMXLIB_OMX_EXPRESSION_PROGRAM_HPP
+
+#include "../include/OmxExpression.hpp"
+
+#include <vector>
+#include <string>
+#include <memory>
+
+namespace omx {
+
+struct OmxExpression::Node {
+	OmxExpression::Op _op;
+	double _value;
+	std::string _name;
+	std::shared_ptr<const Node> _left;
+	std::shared_ptr<const Node> _right;
+};
+
+// An OmxExpression flattened into postfix instructions over blocks of doubles. Matrices and zonal
+// references are numbered in the order of first use; the caller supplies their values.
+class OmxExpressionProgram {
+public:
+	// values for one block of cells, all in the same row
+	static const size_t BLOCK_SIZE = 512;
+
+	OmxExpressionProgram(const OmxExpression& expression);
+
+	const std::vector<std::string>& getMatrixNames() const { return _matrixNames; }
+	const std::vector<std::string>& getReferenceNames() const { return _referenceNames; }
+	size_t getStackDepth() const { return _stackDepth; }
+
+	// evaluates count (<= BLOCK_SIZE) cells of row, starting at column col. matrixValues[k] points to the
+	// values of matrix k for these cells, references[k] to all values of reference k. stack needs
+	// getStackDepth() * BLOCK_SIZE initialized doubles; the result is left at its start.
+	void evaluate(OmxIndex row, OmxIndex col, size_t count, const double * const *matrixValues,
+		const double * const *references, double *stack) const;
+
+private:
+	struct Instruction {
+		OmxExpression::Op _op;
+		size_t _index;
+		double _value;
+	};
+
+	size_t compile(const OmxExpression::Node& node);
+	size_t getIndex(std::vector<std::string> *names, const std::string& name);
+
+	std::vector<Instruction> _instructions;
+	std::vector<std::string> _matrixNames;
+	std::vector<std::string> _referenceNames;
+	size_t _stackDepth;
+};
+
+}
+#endif
@@ -3,16 +3,33 @@
 #include "../include/OmxAttributeCollection.hpp"
 #include "../include/OmxMatrix.hpp"
 #include "../include/OmxZonalReference.hpp"
+#include "../include/OmxChunkPolicy.hpp"
+#include "../include/OmxExpression.hpp"
 
 #include "OmxH5Common.hpp"
 #include "H5Scoped.hpp"
 #include "OmxAttributeOwnerData.hpp"
 #include "OmxFileOwnerData.hpp"
+#include "OmxChunkCache.hpp"
+#include "OmxChunkCodec.hpp"
+#include "OmxParallel.hpp"
+#include "OmxExpressionProgram.hpp"
+#include "OmxDataConversion.hpp"
+#include "OmxCellComparer.hpp"
+#include "OmxIoExecutor.hpp"
 
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <functional>
 #include <fstream>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <cstdio>
+#include <cstring>
 
 #include <hdf5.h>
 #include <hdf5_hl.h>
@@ -29,6 +46,13 @@ static const OmxIndex MAX_CHUNK_DIMS = 2;
 static const size_t IDEAL_CHUNK_SIZE_NO_COMPRESSION = 256000;
 static const size_t IDEAL_CHUNK_SIZE_WITH_COMPRESSION = 320000;
 static const OmxDataType DEFAULT_DATA_TYPE = OmxDataType::Double;
+static const size_t IN_MEMORY_FILE_INCREMENT = 64 * 1024 * 1024;
+static const size_t VACUUM_STRIP_SIZE = 64 * 1024 * 1024;
+static const size_t EVALUATE_STRIP_SIZE = 64 * 1024 * 1024;
+static const size_t TRANSPOSE_MEMORY_BUDGET = 256 * 1024 * 1024;
+static const OmxIndex TRANSPOSE_BLOCK_SIDE = 32;
+static const size_t EXTRACT_STRIP_SIZE = 64 * 1024 * 1024;
+static const size_t COMPARE_STRIP_SIZE = 64 * 1024 * 1024;
 
 
 herr_t datasetNameIterator(hid_t loc_id, const char *name, const H5L_info_t *info, void *opdata)
@@ -38,11 +62,46 @@ herr_t datasetNameIterator(hid_t loc_id, const char *name, const H5L_info_t *inf
 	return 0;
 }
 
+// attributes are copied value for value, H5Ocopy can't copy the root group onto the root of another file
+herr_t attributeCopyIterator(hid_t loc_id, const char *name, const H5A_info_t *info, void *opdata)
+{
+	hid_t dest = *(hid_t *)opdata;
+
+	H5AttributeScoped attribute(H5Aopen(loc_id, name, H5P_DEFAULT));
+	H5TypeScoped type(H5Aget_type(attribute));
+	H5DataspaceScoped space(H5Aget_space(attribute));
+	if (attribute < 0 || type < 0 || space < 0)
+		return -1;
+
+	auto count = std::max<hssize_t>(H5Sget_simple_extent_npoints(space), 1);
+	std::vector<uint8_t> value(H5Tget_size(type) * count);
+	if (H5Aread(attribute, type, value.data()) < 0)
+		return -1;
+
+	H5AttributeScoped copy(H5Acreate2(dest, name, type, space, H5P_DEFAULT, H5P_DEFAULT));
+	herr_t status = copy >= 0 ? H5Awrite(copy, type, value.data()) : -1;
+
+	if (H5Tdetect_class(type, H5T_VLEN) > 0 || H5Tis_variable_str(type) > 0)
+		H5Dvlen_reclaim(type, space, H5P_DEFAULT, value.data());
+
+	return status;
+}
+
 typedef std::function<bool(OmxDataType)> ValidDatasetDataTypeFn_t;
+
+// Datasets found when a file is opened are only listed by name; the dataset is opened and its
+// object created on first access through loadFn.
 template <typename T>
 struct NamedDatasetObjectCollection {
+	typedef std::function<T*(const std::string&)> LoadFn_t;
+
+	struct Entry {
+		std::string _name;
+		std::unique_ptr<T> _object;
+	};
+
 	NamedDatasetObjectCollection(const std::string& typeName, const std::string& typeNamePlural, const std::string& parentPath, ValidDatasetDataTypeFn_t validDataTypeFn)
-		: _typeName(typeName), _parentPath(parentPath), _typeNamePlural(typeNamePlural), _validDataTypeFn(validDataTypeFn), _datasets(), _entries() {
+		: _typeName(typeName), _parentPath(parentPath), _typeNamePlural(typeNamePlural), _validDataTypeFn(validDataTypeFn), _entries() {
 		
 	}
 
@@ -54,32 +113,34 @@ struct NamedDatasetObjectCollection {
 		clear();
 	}
 
-	void add(const std::string& name, hid_t dataset, T *t) {
-		_datasets[name] = std::make_unique<H5DatasetScoped>(dataset);
-		_entries.push_back(std::unique_ptr<T>(t));
+	void add(T *t) {
+		_index[t->getName()] = _entries.size();
+		_entries.push_back(Entry{ t->getName(), std::unique_ptr<T>(t) });
 	}
 
-	bool exists(const std::string& name) const {
+	void addUnloaded(const std::string& name) {
+		_index[name] = _entries.size();
+		_entries.push_back(Entry{ name, nullptr });
+	}
 
-		return std::find_if(_entries.cbegin(), _entries.cend(),
-			[&name](const std::unique_ptr<T> &e) { return e->getName() == name; }) != _entries.cend();
+	bool exists(const std::string& name) const {
+		return _index.find(name) != _index.end();
 	}
 
 	std::vector<std::string> getNames() const {
 		std::vector<std::string> names;
 
 		for (const auto &e : _entries) {
-			names.push_back(e->getName());
+			names.push_back(e._name);
 		}
 
 		return names;
 	}
 
 	T* getEntry(const std::string& name) const {
-		for (const auto& e : _entries) {
-			if (e->getName() == name)
-				return e.get();
-		}
+		auto it = _index.find(name);
+		if (it != _index.end())
+			return load(_entries[it->second]);
 
 		throw OmxFileException("Couldn't find " + _typeName + " with name '" + name + "'.");
 	}
@@ -88,7 +149,35 @@ struct NamedDatasetObjectCollection {
 		if (index >= size())
 			throw OmxFileException("Index out of range.");
 
-		return _entries[index].get();
+		return load(_entries[index]);
+	}
+
+	// null when the object was never created
+	T* getLoadedEntry(const std::string& name) const {
+		auto it = _index.find(name);
+		return it != _index.end() ? _entries[it->second]._object.get() : nullptr;
+	}
+
+	// only objects that were created, entries never accessed have nothing to write or close
+	void forEachLoaded(const std::function<void(T*)>& fn) const {
+		for (auto& e : _entries) {
+			if (e._object)
+				fn(e._object.get());
+		}
+	}
+
+	void remove(const std::string& name) {
+		auto it = _index.find(name);
+		if (it == _index.end())
+			return;
+
+		// entries keep their creation order, the ones after the removed entry move up by one
+		size_t position = it->second;
+		_entries.erase(_entries.begin() + position);
+		_index.erase(it);
+
+		for (size_t i = position; i < _entries.size(); i++)
+			_index[_entries[i]._name] = i;
 	}
 
 	inline size_t size() const {
@@ -97,15 +186,29 @@ struct NamedDatasetObjectCollection {
 
 	void clear() {
 		_entries.clear();
-		_datasets.clear();
+		_index.clear();
 	}
 
 	std::string _typeName;
 	std::string _typeNamePlural;
 	std::string _parentPath;
 	ValidDatasetDataTypeFn_t _validDataTypeFn;
-	std::map<std::string, std::unique_ptr<H5DatasetScoped>> _datasets;
-	std::vector<std::unique_ptr<T>> _entries;
+	LoadFn_t _loadFn;
+
+private:
+	T* load(Entry& entry) const {
+		std::lock_guard<std::mutex> lock(_loadMutex);
+
+		if (!entry._object)
+			entry._object.reset(_loadFn(entry._name));
+
+		return entry._object.get();
+	}
+
+	// entries in creation order and the position of each name among them
+	mutable std::vector<Entry> _entries;
+	std::unordered_map<std::string, size_t> _index;
+	mutable std::mutex _loadMutex;
 };
 
 static bool isValidMatrixDataType(OmxDataType dataType) {
@@ -127,14 +230,22 @@ public:
 		_mats("matrix", "matrices", HDF5_PATH_MATRICES, &isValidMatrixDataType),
 		_zonals("zonal reference", "zonal references", HDF5_PATH_ZONAL_REFS, &isValidZonalReferenceDataType),
 		_isInitialized( false ),
+		_isInMemory( false ),
 		_compressionLevel( OmxCompressionLevel::NoCompression ),
+		_compressionCodec( OmxCompressionCodec::Deflate ),
+		_chunkPolicy( OmxChunkPolicy::defaultPolicy() ),
 		_attributes( nullptr ),
 		_version( OmxVersion::v0_3_0 ),
 		_handle( nullptr ) {
+		registerCompressionFilters();
 	}
 
 	~OmxFileImpl() {
-		close();
+		try {
+			close();
+		}
+		catch (...) {
+		}
 	}
 
 	inline bool hasValidHandle() const { return _handle != nullptr && *_handle >= 0; }
@@ -186,16 +297,15 @@ public:
 	}
 	
 	void readMatrices() {
-		readDatasets<OmxMatrix, OmxMatrixException>(&_mats, true, nullptr, &matrixFactory);
+		readDatasets<OmxMatrix, OmxMatrixException>(&_mats, &matrixFactory);
 	}
 
 	void readZonalReferences() {
-		readDatasets<OmxZonalReference, OmxZonalReferenceException>(&_zonals, true, nullptr, &zonalReferenceFactory);
+		readDatasets<OmxZonalReference, OmxZonalReferenceException>(&_zonals, &zonalReferenceFactory);
 	}
 	
-	// TODO: this checking of the dataset types to only have one type for certain sorts of datatypes may be removed
 	template <typename T, typename E>
-	void readDatasets(NamedDatasetObjectCollection<T> *collection, bool allowMultipleDataTypes, hid_t *firstH5Type, DatasetObjectFactory_t factoryFn) {
+	void readDatasets(NamedDatasetObjectCollection<T> *collection, DatasetObjectFactory_t factoryFn) {
 		requireValidHandle();
 	
 		std::string typeName = collection->_typeName;
@@ -216,46 +326,40 @@ public:
 		std::vector<std::string> datasetNames;
 		auto indexType = flags & H5P_CRT_ORDER_TRACKED ? H5_INDEX_CRT_ORDER : H5_INDEX_NAME;
 		H5Literate(group, indexType, H5_ITER_INC, NULL, datasetNameIterator, &datasetNames);
-	
-		hid_t datasetType = -1;
-	
-		for (auto name : datasetNames) {
-			// filters
-			hid_t dataset = openDataset(collection->_parentPath, name, typeName);
-			if (dataset < 0)
-				E("Couldn't open " + typeName + " '" + name + ".");
-	
-			H5PlistScoped plist{ H5Dget_create_plist(dataset) };
-	
-			if (plist < 0)
-				E("Couldn't read metadata for " + typeName + " '" + name + ".");
-	
-			H5TypeScoped datasetType2(H5Dget_type(dataset));
-			if (datasetType2 < 0)
-				throw E("Couldn't determine type information for " + typeName + " '" + name + "'.");
-	
-			hid_t directType = getH5DirectDataType(datasetType2);
 
-			if (!collection->_validDataTypeFn(getOmxDataType(directType)))
-				throw E("Invalid data type detected for " + typeName + " '" + name + ".");
-			
-			if (datasetType == -1) {
-				datasetType = directType;
+		collection->_loadFn = [this, collection, factoryFn](const std::string& name) {
+			return loadDataset<T, E>(collection, name, factoryFn);
+		};
 
-				if (firstH5Type)
-					*firstH5Type = directType;
-			}
-			else if (datasetType != directType && !allowMultipleDataTypes) {
-				if (dataset >= 0)
-					H5Dclose(dataset);
-	
-				throw E("Contains " + collection->_typeNamePlural + " of more than one of the supported data types, which is not allowed.");
-			}
+		for (auto& name : datasetNames)
+			collection->addUnloaded(name);
+	}
 
-			// all checks passed, add to list
-			OmxFileOwnerData ownerData{ *_handle, dataset };
-			collection->add(name, dataset, static_cast<T*>(factoryFn(name, _zones, _compressionLevel, directType, &ownerData)));
+	template <typename T, typename E>
+	T* loadDataset(NamedDatasetObjectCollection<T> *collection, const std::string& name, DatasetObjectFactory_t factoryFn) {
+		requireValidHandle();
+
+		std::string typeName = collection->_typeName;
+
+		hid_t dataset = openDataset(collection->_parentPath, name, typeName);
+		if (dataset < 0)
+			throw E("Couldn't open " + typeName + " '" + name + "'.");
+
+		H5TypeScoped datasetType(H5Dget_type(dataset));
+		if (datasetType < 0) {
+			H5Dclose(dataset);
+			throw E("Couldn't determine type information for " + typeName + " '" + name + "'.");
+		}
+
+		hid_t directType = getH5DirectDataType(datasetType);
+
+		if (!collection->_validDataTypeFn(getOmxDataType(directType))) {
+			H5Dclose(dataset);
+			throw E("Invalid data type detected for " + typeName + " '" + name + "'.");
 		}
+
+		OmxFileOwnerData ownerData{ *_handle, dataset, collection->_parentPath + "/" + name, &_cacheBudget, [this]() { waitForBackgroundReads(); } };
+		return static_cast<T*>(factoryFn(name, _zones, _compressionLevel, directType, &ownerData));
 	}
 
 	static OmxMatrix *matrixFactory(const std::string& name, OmxIndex zones, OmxCompressionLevel compressionLevel, hid_t h5Type, const OmxFileOwnerData *ownerData)
@@ -297,12 +401,59 @@ public:
 		_isInitialized = true;
 	}
 
-	void setChunkSize2D(hsize_t *chunkData, OmxIndex zones, size_t dataTypeSize, OmxCompressionLevel compressionLevel) {
-		auto rowSize = dataTypeSize * zones;
-		size_t idealChunkDataSize = compressionLevel == OmxCompressionLevel::NoCompression 
-			? IDEAL_CHUNK_SIZE_NO_COMPRESSION : IDEAL_CHUNK_SIZE_WITH_COMPRESSION;
+	void setChunkSize2D(hsize_t *chunkData, OmxIndex zones, size_t dataTypeSize, OmxCompressionLevel compressionLevel, const OmxChunkPolicy& chunkPolicy) {
+		auto rowSize = std::max<size_t>(dataTypeSize * zones, 1);
+		size_t idealChunkDataSize = chunkPolicy.getTargetChunkSize();
 
-		size_t maxZonesPerRowFit = idealChunkDataSize / dataTypeSize;
+		if (idealChunkDataSize == 0) {
+			idealChunkDataSize = compressionLevel == OmxCompressionLevel::NoCompression 
+				? IDEAL_CHUNK_SIZE_NO_COMPRESSION : IDEAL_CHUNK_SIZE_WITH_COMPRESSION;
+		}
+
+		size_t maxZonesPerRowFit = std::max<size_t>(idealChunkDataSize / dataTypeSize, 1);
+
+		auto kind = chunkPolicy.getKind();
+		if (kind == OmxChunkPolicy::Kind::AccessPattern) {
+			switch (chunkPolicy.getAccessPattern()) {
+			case OmxAccessPattern::Sequential:	kind = OmxChunkPolicy::Kind::RowStrip; break;
+			case OmxAccessPattern::Block:		kind = OmxChunkPolicy::Kind::SquareTile; break;
+			case OmxAccessPattern::Random:
+				// a random row should only ever touch the chunk holding it
+				chunkData[0] = 1;
+				chunkData[1] = zones;
+				return;
+			case OmxAccessPattern::Column:
+				// full height strips of as many columns as fit
+				chunkData[0] = zones;
+				chunkData[1] = std::min<OmxIndex>(zones, std::max<size_t>(idealChunkDataSize / rowSize, 1));
+				return;
+			}
+		}
+
+		switch (kind) {
+		case OmxChunkPolicy::Kind::RowStrip:
+			chunkData[0] = std::min<OmxIndex>(zones, std::max<size_t>(idealChunkDataSize / rowSize, 1));
+			chunkData[1] = zones;
+			return;
+
+		case OmxChunkPolicy::Kind::SquareTile: {
+			OmxIndex side = chunkPolicy.getDims().rows;
+			if (side == 0)
+				side = std::max<OmxIndex>((OmxIndex)std::sqrt((double)maxZonesPerRowFit), 1);
+
+			chunkData[0] = std::min(zones, side);
+			chunkData[1] = std::min(zones, side);
+			return;
+		}
+
+		case OmxChunkPolicy::Kind::Explicit:
+			chunkData[0] = std::min(zones, chunkPolicy.getDims().rows);
+			chunkData[1] = std::min(zones, chunkPolicy.getDims().columns);
+			return;
+
+		default:
+			break;
+		}
 
 		if (zones == maxZonesPerRowFit) {
 			chunkData[0] = 1;
@@ -315,7 +466,7 @@ public:
 		}
 		else {
 			chunkData[0] = 1;
-			chunkData[1] = idealChunkDataSize / dataTypeSize;
+			chunkData[1] = maxZonesPerRowFit;
 		}
 	}
 
@@ -328,9 +479,11 @@ public:
 	hid_t addH5Dataset(NamedDatasetObjectCollection<T> *collection,
 					   const std::string& name,
 					   OmxCompressionLevel compressionLevel,
+					   OmxCompressionCodec compressionCodec,
 					   int numDims,
 					   const hsize_t *dims,
 					   hid_t h5Type,
+					   const OmxChunkPolicy& chunkPolicy,
 					   std::function<void(hid_t)> *additionalPlistFn,
 					   DatasetObjectFactory_t factoryFn) {
 
@@ -348,9 +501,13 @@ public:
 			throw E("A " + datasetTypeName + " with the name '" + name + "' already exists.");
 
 		
+		bool isContiguous = numDims == 2 && chunkPolicy.getKind() == OmxChunkPolicy::Kind::Contiguous;
+		if (isContiguous && compressionLevel != OmxCompressionLevel::NoCompression)
+			throw E("A contiguous " + datasetTypeName + " can't be compressed.");
+
 		hsize_t chunkSize[2];
 		if (numDims == 2) {
-			setChunkSize2D(chunkSize, _zones, getDataTypeSize(getOmxDataType(h5Type)), compressionLevel);
+			setChunkSize2D(chunkSize, _zones, getDataTypeSize(getOmxDataType(h5Type)), compressionLevel, chunkPolicy);
 		}
 		else if(numDims == 1) {
 			setChunkSize1D(chunkSize, _zones, getDataTypeSize(getOmxDataType(h5Type)));
@@ -369,14 +526,21 @@ public:
 		if (plist < 0)
 			throw E("Couldn't prepare metadata parameters for new " + datasetTypeName + ".");
 
-		if (H5Pset_chunk(plist, numDims, chunkSize) < 0)
+		if (isContiguous) {
+			// allocated up front so the storage has an address to map
+			if (H5Pset_layout(plist, H5D_CONTIGUOUS) < 0 || H5Pset_alloc_time(plist, H5D_ALLOC_TIME_EARLY) < 0)
+				throw E("Couldn't set data parameters for new " + datasetTypeName + ".");
+		}
+		else if (H5Pset_chunk(plist, numDims, chunkSize) < 0) {
 			throw E("Couldn't set data parameters for new " + datasetTypeName + ".");
-
-		if (compressionLevel != OmxCompressionLevel::NoCompression) {
-			if (H5Pset_deflate(plist, getH5CompressionLevelFromOmx(compressionLevel)) < 0)
-				throw E("Couldn't set compression level for new " + datasetTypeName + ".");
 		}
 
+		if (compressionLevel != OmxCompressionLevel::NoCompression && !isCompressionCodecAvailable(compressionCodec))
+			throw E("The compression codec for new " + datasetTypeName + " is not available in this build.");
+
+		if (!setH5CompressionFilters(plist, compressionCodec, compressionLevel))
+			throw E("Couldn't set compression level for new " + datasetTypeName + ".");
+
 		if (additionalPlistFn)
 			(*additionalPlistFn)(plist);
 
@@ -386,8 +550,8 @@ public:
 			throw E("Error creating " + datasetTypeName + " '" + name + "'.");
 		}
 
-		OmxFileOwnerData ownerData{ *_handle, dataset };
-		collection->add(name, dataset, static_cast<T*>(factoryFn(name, _zones, compressionLevel, h5Type, &ownerData)));
+		OmxFileOwnerData ownerData{ *_handle, dataset, path, &_cacheBudget, [this]() { waitForBackgroundReads(); } };
+		collection->add(static_cast<T*>(factoryFn(name, _zones, compressionLevel, h5Type, &ownerData)));
 
 		return dataset;
 	}
@@ -398,14 +562,24 @@ public:
 		if (!collection->exists(name))
 			throw E("No " + collection->_typeName + " found with name '" + name + ".");
 
+		cancelRowPrefetch();
+		waitForIo();
+		discardBeforeRemoval(collection->getLoadedEntry(name));
+
 		if (H5Ldelete(*_handle, (collection->_parentPath + "/" + name).c_str(), H5P_DEFAULT) < 0) {
 			throw E("Couldn't remove " + collection->_typeName + " '" + name + "'.");
 		}
 
-		collection->_datasets.erase(collection->_datasets.find(name));
-		collection->_entries.erase(std::remove_if(collection->_entries.begin(), collection->_entries.end(),
-			[&name](const std::unique_ptr<T> &m) { return m.get()->getName() == name; }),
-			collection->_entries.end());
+		collection->remove(name);
+	}
+
+	// a matrix being removed drops its collected rows and statistics, they have nowhere to go
+	static void discardBeforeRemoval(OmxMatrix *matrix) {
+		if (matrix)
+			matrix->discard();
+	}
+
+	static void discardBeforeRemoval(OmxZonalReference *) {
 	}
 
 	bool matrixNameExists(const std::string& name) const {
@@ -425,30 +599,408 @@ public:
 		return name.length() > 0;
 	}
 
+	void flushMatrices() {
+		cancelRowPrefetch();
+		waitForIo();
+
+		// every matrix is flushed even after one failed, the first error is reported; whatever is
+		// left to the matrix destructors can only fail silently
+		std::exception_ptr flushError;
+		_mats.forEachLoaded([&flushError](OmxMatrix *m) {
+			try {
+				m->close();
+			}
+			catch (...) {
+				if (!flushError)
+					flushError = std::current_exception();
+			}
+		});
+
+		if (flushError)
+			std::rethrow_exception(flushError);
+	}
+
+	// the core driver keeps the whole file in memory; nothing is written back to disk
+	static hid_t createInMemoryAccessPlist() {
+		hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+		if (fapl < 0 || H5Pset_fapl_core(fapl, IN_MEMORY_FILE_INCREMENT, false) < 0) {
+			if (fapl >= 0)
+				H5Pclose(fapl);
+
+			throw OmxFileException("Couldn't prepare in-memory file access.");
+		}
+
+		return fapl;
+	}
+
+	// rows that readRows() reads ahead in the background for the call with the next row
+	struct RowPrefetch {
+		OmxIndex _row;
+		OmxRowLayout _layout;
+		std::vector<OmxMatrix *> _matrices;
+		std::vector<uint64_t> _writeGenerations;
+		std::vector<uint8_t> _buffer;
+		std::future<void> _task;
+	};
+
+	// waits for a running prefetch; a failed one is dropped and its rows are read again when needed
+	std::unique_ptr<RowPrefetch> takeRowPrefetch() {
+		std::unique_ptr<RowPrefetch> prefetch(std::move(_rowPrefetch));
+
+		if (prefetch && prefetch->_task.valid()) {
+			try {
+				prefetch->_task.get();
+			}
+			catch (...) {
+				prefetch.reset();
+			}
+		}
+
+		return prefetch;
+	}
+
+	// started with the first asynchronous request, matrices are looked up by name on its thread
+	OmxIoExecutor& ioExecutor() {
+		requireValidHandle();
+
+		std::lock_guard<std::mutex> lock(_ioExecutorMutex);
+		if (!_ioExecutor)
+			_ioExecutor.reset(new OmxIoExecutor([this](const std::string& name) { return _mats.getEntry(name); }));
+
+		return *_ioExecutor;
+	}
+
+	void waitForIo() {
+		OmxIoExecutor *executor;
+		{
+			std::lock_guard<std::mutex> lock(_ioExecutorMutex);
+			executor = _ioExecutor.get();
+		}
+
+		if (executor)
+			executor->drain();
+	}
+
+	// for matrices about to reopen their dataset; a finished prefetch is still handed out by readRows()
+	void waitForBackgroundReads() {
+		if (_rowPrefetch && _rowPrefetch->_task.valid())
+			_rowPrefetch->_task.wait();
+
+		waitForIo();
+	}
+
+	void cancelRowPrefetch() {
+		takeRowPrefetch();
+	}
+
+	static std::vector<uint64_t> getWriteGenerations(const std::vector<OmxMatrix *>& matrices) {
+		std::vector<uint64_t> generations;
+		for (auto m : matrices)
+			generations.push_back(m->getWriteGeneration());
+
+		return generations;
+	}
+
+	// the chunk rows of all matrices that have to be decoded are fetched first and decoded together
+	void decodeChunkRows(OmxIndex row, const std::vector<OmxMatrix *>& matrices) {
+		std::vector<std::pair<OmxMatrix *, OmxIndex>> chunks;
+		std::vector<OmxMatrix *> decoded;
+
+		for (auto m : matrices) {
+			if (std::find(decoded.begin(), decoded.end(), m) != decoded.end())
+				continue;
+
+			auto chunkCount = m->fetchChunkRow(row);
+			if (chunkCount == 0)
+				continue;
+
+			decoded.push_back(m);
+			for (OmxIndex i = 0; i < chunkCount; i++)
+				chunks.emplace_back(m, i);
+		}
+
+		if (chunks.empty())
+			return;
+
+		parallelFor((OmxIndex)chunks.size(), std::max<uint32_t>(std::thread::hardware_concurrency(), 1), [&](OmxIndex i) {
+			chunks[i].first->decodeFetchedChunk(chunks[i].second);
+		});
+
+		for (auto m : decoded)
+			m->finishChunkRow();
+	}
+
+	void readRowsInto(OmxIndex row, const std::vector<OmxMatrix *>& matrices, OmxRowLayout layout, uint8_t *buffer, bool isBackground) {
+		if (!isBackground)
+			decodeChunkRows(row, matrices);
+
+		bool isInterleaved = layout == OmxRowLayout::Interleaved;
+		OmxIndex stride = isInterleaved ? matrices.size() : 1;
+		size_t offset = 0;
+
+		for (auto m : matrices) {
+			m->readRowStrided(row, buffer + offset, stride, isBackground);
+			offset += isInterleaved ? getDataTypeSize(m->getDataType()) : m->getDataSize();
+		}
+	}
+
+	void readRows(OmxIndex row, const std::vector<std::string>& matrixNames, void *buffer, OmxRowLayout layout, bool prefetchNext) {
+		requireValidHandle();
+
+		if (row >= _zones)
+			throw std::out_of_range("Row index " + std::to_string(row) + " was out of the acceptable range.");
+
+		std::vector<OmxMatrix *> matrices;
+		size_t rowsSize = 0;
+		for (auto& name : matrixNames) {
+			matrices.push_back(_mats.getEntry(name));
+			rowsSize += matrices.back()->getDataSize();
+		}
+
+		if (layout == OmxRowLayout::Interleaved) {
+			for (auto m : matrices) {
+				if (m->getDataType() != matrices.front()->getDataType())
+					throw OmxMatrixException("Interleaved rows need matrices of one data type.");
+			}
+		}
+
+		auto prefetch = takeRowPrefetch();
+		bool isPrefetched = prefetch && prefetch->_row == row && prefetch->_layout == layout
+			&& prefetch->_matrices == matrices && prefetch->_writeGenerations == getWriteGenerations(matrices);
+
+		if (isPrefetched)
+			std::memcpy(buffer, prefetch->_buffer.data(), rowsSize);
+		else
+			readRowsInto(row, matrices, layout, (uint8_t *)buffer, false);
+
+		// the background read goes through HDF5 alone, which has to serialize it with the caller's calls
+		if (!prefetchNext || row + 1 >= _zones || !isH5ThreadSafe())
+			return;
+
+		if (!prefetch)
+			prefetch.reset(new RowPrefetch());
+
+		prefetch->_row = row + 1;
+		prefetch->_layout = layout;
+		prefetch->_matrices = matrices;
+		prefetch->_writeGenerations = getWriteGenerations(matrices);
+		prefetch->_buffer.resize(rowsSize);
+
+		auto next = prefetch.get();
+		next->_task = std::async(std::launch::async, [this, next]() {
+			readRowsInto(next->_row, next->_matrices, next->_layout, next->_buffer.data(), true);
+		});
+
+		_rowPrefetch = std::move(prefetch);
+	}
+
+	// H5Ocopy moves the stored chunks and the attributes of the dataset unchanged
+	void copyMatrixFrom(OmxFileImpl& other, const std::string& name, const std::string& newName) {
+		requireValidHandle();
+		other.requireValidHandle();
+
+		if (other._zones != _zones) {
+			throw OmxFileException("Matrix '" + name + "' has " + std::to_string(other._zones) + " zones, file '"
+				+ _filename + "' has " + std::to_string(_zones) + ".");
+		}
+
+		if (!isValidDatasetName(newName))
+			throw OmxMatrixException("The name '" + newName + "' is not a valid matrix name.");
+
+		if (_mats.exists(newName))
+			throw OmxMatrixException("A matrix with the name '" + newName + "' already exists.");
+
+		// rows the source still holds back have to be stored before its chunks are copied
+		other._mats.getEntry(name)->close();
+
+		std::string path = std::string(HDF5_PATH_MATRICES) + "/" + name;
+		std::string newPath = std::string(HDF5_PATH_MATRICES) + "/" + newName;
+		if (H5Ocopy(*other._handle, path.c_str(), *_handle, newPath.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+			throw OmxMatrixException("Couldn't copy matrix '" + name + "'.");
+
+		_mats.add(loadDataset<OmxMatrix, OmxMatrixException>(&_mats, newName, &matrixFactory));
+	}
+
+	static void copyAttributes(hid_t src, hid_t dest) {
+		hsize_t index = 0;
+		if (H5Aiterate2(src, H5_INDEX_NAME, H5_ITER_INC, &index, attributeCopyIterator, &dest) < 0)
+			throw OmxFileException("Couldn't copy attributes.");
+	}
+
+	// Writes the live objects of the file to path. Objects are copied with H5Ocopy, which moves the
+	// stored chunks unchanged; with copyRawChunks false matrices are instead read and written again,
+	// decompressing and compressing on all cores.
+	void writeCompactCopy(const std::string& path, bool copyRawChunks) {
+		H5PlistScoped fcpl(H5Fget_create_plist(*_handle));
+		if (fcpl < 0)
+			throw OmxFileException("Couldn't read file creation properties.");
+
+		H5FileScoped dest(H5Fcreate(path.c_str(), H5F_ACC_TRUNC, fcpl, H5P_DEFAULT));
+		if (dest < 0)
+			throw OmxFileException("Couldn't create '" + path + "'.");
+
+		copyAttributes(*_handle, dest);
+
+		std::vector<std::string> names;
+		H5Literate(*_handle, H5_INDEX_NAME, H5_ITER_INC, NULL, datasetNameIterator, &names);
+
+		for (auto& name : names) {
+			if (!copyRawChunks && "/" + name == HDF5_PATH_MATRICES) {
+				rewriteMatrices(dest);
+				continue;
+			}
+
+			if (H5Ocopy(*_handle, name.c_str(), dest, name.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+				throw OmxFileException("Couldn't copy '" + name + "'.");
+		}
+	}
+
+	void rewriteMatrices(hid_t dest) {
+		H5GroupScoped srcGroup(H5Gopen(*_handle, HDF5_PATH_MATRICES, H5P_DEFAULT));
+		H5PlistScoped gcpl(H5Gget_create_plist(srcGroup));
+		H5GroupScoped destGroup(H5Gcreate(dest, HDF5_PATH_MATRICES, H5P_DEFAULT, gcpl, H5P_DEFAULT));
+		if (srcGroup < 0 || gcpl < 0 || destGroup < 0)
+			throw OmxFileException("Couldn't copy matrices.");
+
+		copyAttributes(srcGroup, destGroup);
+
+		auto threads = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+
+		for (auto& name : _mats.getNames()) {
+			auto src = _mats.getEntry(name);
+			std::string path = std::string(HDF5_PATH_MATRICES) + "/" + name;
+
+			H5DatasetScoped srcDataset(H5Dopen(*_handle, path.c_str(), H5P_DEFAULT));
+			H5PlistScoped dcpl(H5Dget_create_plist(srcDataset));
+			H5TypeScoped type(H5Dget_type(srcDataset));
+			H5DataspaceScoped space(H5Dget_space(srcDataset));
+			if (srcDataset < 0 || dcpl < 0 || type < 0 || space < 0)
+				throw OmxFileException("Couldn't read matrix '" + name + "'.");
+
+			hid_t dataset = H5Dcreate2(dest, path.c_str(), type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+			if (dataset < 0)
+				throw OmxFileException("Couldn't copy matrix '" + name + "'.");
+
+			OmxFileOwnerData ownerData{ dest, dataset, path, nullptr, nullptr };
+			std::unique_ptr<OmxMatrix> copy(new OmxMatrix(src->getDataType(), _zones, name, src->getCompressionLevel(), &ownerData));
+			copyAttributes(srcDataset, dataset);
+
+			src->setDecompressionThreads(threads);
+			copy->setCompressionThreads(threads);
+
+			// strips of whole chunk rows keep both sides on their direct chunk paths
+			auto chunkRows = std::max<OmxIndex>(copy->getChunkDims().rows, 1);
+			auto stripRows = chunkRows * std::max<OmxIndex>(VACUUM_STRIP_SIZE / std::max<size_t>(src->getDataSize() * chunkRows, 1), 1);
+			stripRows = std::min(stripRows, _zones);
+
+			std::unique_ptr<uint8_t[]> strip(new uint8_t[stripRows * src->getDataSize()]);
+			for (OmxIndex row = 0; row < _zones; row += stripRows) {
+				auto rowCount = std::min(stripRows, _zones - row);
+				src->readBlock(row, rowCount, 0, _zones, strip.get());
+				copy->writeBlock(row, rowCount, 0, _zones, strip.get());
+			}
+
+			copy->close();
+		}
+	}
+
+	size_t vacuum(bool copyRawChunks) {
+		requireValidHandle();
+
+		if (_isInMemory)
+			throw OmxFileException("In-memory files can't be vacuumed, use flushTo() to write a compact copy.");
+
+		unsigned int intent = 0;
+		if (H5Fget_intent(*_handle, &intent) < 0 || !(intent & H5F_ACC_RDWR))
+			throw OmxFileException("Only files opened for writing can be vacuumed.");
+
+		flushMatrices();
+
+		if (H5Fflush(*_handle, H5F_SCOPE_LOCAL) < 0)
+			throw OmxFileException("Couldn't flush the file.");
+
+		hsize_t sizeBefore = 0, sizeAfter = 0;
+		H5Fget_filesize(*_handle, &sizeBefore);
+
+		std::string tempFilename = _filename + ".vacuum";
+		try {
+			writeCompactCopy(tempFilename, copyRawChunks);
+		}
+		catch (...) {
+			std::remove(tempFilename.c_str());
+			throw;
+		}
+
+		close();
+
+		// rename() replaces the file atomically on POSIX systems, Windows won't rename onto an existing file
+#if defined(_WIN32)
+		std::remove(_filename.c_str());
+#endif
+		bool isReplaced = std::rename(tempFilename.c_str(), _filename.c_str()) == 0;
+		if (!isReplaced)
+			std::remove(tempFilename.c_str());
+
+		auto file = H5Fopen(_filename.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+		if (file < 0)
+			throw OmxFileException("Could not reopen file after vacuum.");
+
+		_handle = std::make_unique<H5FileScoped>(file);
+		initialize(false);
+
+		if (!isReplaced)
+			throw OmxFileException("Couldn't replace the file with its compacted copy.");
+
+		H5Fget_filesize(*_handle, &sizeAfter);
+
+		return sizeBefore > sizeAfter ? (size_t)(sizeBefore - sizeAfter) : 0;
+	}
+
 	void close() {
 		if (hasValidHandle()) {
-			_handle.reset(nullptr);
-			_attributes.reset(nullptr);
+			// matrices may still hold buffered rows, write them before any handles go away
+			std::exception_ptr flushError;
+			try {
+				flushMatrices();
+			}
+			catch (...) {
+				flushError = std::current_exception();
+			}
 
+			_ioExecutor.reset(nullptr);
 			_mats.clear();
 			_zonals.clear();
+			_attributes.reset(nullptr);
+			_handle.reset(nullptr);
+			_isInMemory = false;
 			_isInitialized = false;
+
+			if (flushError)
+				std::rethrow_exception(flushError);
 		}
 	}
 
 	std::string _filename;
 	std::unique_ptr<H5FileScoped> _handle;
+	OmxChunkCacheBudget _cacheBudget;
 	OmxIndex _zones;
 	bool _isInitialized;
+	bool _isInMemory;
 	OmxVersion _version;
 
 	OmxCompressionLevel _compressionLevel;
+	OmxCompressionCodec _compressionCodec;
+	OmxChunkPolicy _chunkPolicy;
 
 	NamedDatasetObjectCollection<OmxMatrix> _mats;
 	NamedDatasetObjectCollection<OmxZonalReference> _zonals;
 
 	std::unique_ptr<OmxAttributeCollection> _attributes;
 
+	std::unique_ptr<RowPrefetch> _rowPrefetch;
+
+	std::mutex _ioExecutorMutex;
+	std::unique_ptr<OmxIoExecutor> _ioExecutor;
 };
 
 OmxFile::OmxFile(const std::string& filename) : _impl{ new OmxFileImpl{ filename } } {
@@ -522,6 +1074,71 @@ void OmxFile::openWithCreate(OmxIndex zones) {
 	}
 }
 
+void OmxFile::openInMemory(OmxIndex zones) {
+	if (_impl->hasValidHandle())
+		throw OmxFileException("File already open.");
+
+	H5PlistScoped fapl(OmxFileImpl::createInMemoryAccessPlist());
+	auto file = H5Fcreate(_impl->_filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, fapl);
+
+	if (file < 0) {
+		throw OmxFileException("Could not create in-memory file.");
+	}
+
+	_impl->_handle = std::make_unique<H5FileScoped>(file);
+	_impl->_isInMemory = true;
+
+	_impl->_zones = zones;
+	_impl->initialize(true);
+}
+
+void OmxFile::openIntoMemory() {
+	if (_impl->hasValidHandle())
+		throw OmxFileException("File already open.");
+
+	H5PlistScoped fapl(OmxFileImpl::createInMemoryAccessPlist());
+	auto file = H5Fopen(_impl->_filename.c_str(), H5F_ACC_RDWR, fapl);
+
+	if (file < 0) {
+		throw OmxFileException("Could not open file into memory.");
+	}
+
+	_impl->_handle = std::make_unique<H5FileScoped>(file);
+	_impl->_isInMemory = true;
+
+	_impl->initialize(false);
+}
+
+bool OmxFile::isInMemory() const {
+	_impl->requireValidHandle();
+
+	return _impl->_isInMemory;
+}
+
+void OmxFile::flushTo(const std::string& path) {
+	_impl->requireValidHandle();
+
+	_impl->flushMatrices();
+
+	if (H5Fflush(*_impl->_handle, H5F_SCOPE_GLOBAL) < 0)
+		throw OmxFileException("Couldn't flush the file.");
+
+	ssize_t imageSize = H5Fget_file_image(*_impl->_handle, NULL, 0);
+	if (imageSize < 0)
+		throw OmxFileException("Couldn't determine the file image size.");
+
+	std::vector<char> image(imageSize);
+	if (H5Fget_file_image(*_impl->_handle, image.data(), image.size()) < 0)
+		throw OmxFileException("Couldn't get the file image.");
+
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(image.data(), image.size());
+	out.close();
+
+	if (!out)
+		throw OmxFileException("Couldn't write the file to '" + path + "'.");
+}
+
 OmxVersion OmxFile::getVersion() const {
 	_impl->requireValidHandle();
 
@@ -562,13 +1179,26 @@ OmxMatrix& OmxFile::addMatrix(const std::string& name, OmxDataType dataType) {
 }
 
 OmxMatrix& OmxFile::addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel) {
+	return addMatrix(name, dataType, compressionLevel, _impl->_chunkPolicy);
+}
+
+OmxMatrix& OmxFile::addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, const OmxChunkPolicy& chunkPolicy) {
+	return addMatrix(name, dataType, compressionLevel, _impl->_compressionCodec, chunkPolicy);
+}
+
+OmxMatrix& OmxFile::addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, OmxCompressionCodec compressionCodec) {
+	return addMatrix(name, dataType, compressionLevel, compressionCodec, _impl->_chunkPolicy);
+}
+
+OmxMatrix& OmxFile::addMatrix(const std::string& name, OmxDataType dataType, OmxCompressionLevel compressionLevel, OmxCompressionCodec compressionCodec, const OmxChunkPolicy& chunkPolicy) {
 	if (dataType == OmxDataType::String || dataType == OmxDataType::Unknown)
 		throw OmxMatrixException("Unsupported data type for matrices.");
 
 	hsize_t  dims[2] = { _impl->_zones, _impl->_zones };
 
-	hid_t dataset = _impl->addH5Dataset<OmxMatrix, OmxFileException>(&_impl->_mats, name, compressionLevel, 2, dims,
+	hid_t dataset = _impl->addH5Dataset<OmxMatrix, OmxFileException>(&_impl->_mats, name, compressionLevel, compressionCodec, 2, dims,
 		getH5DataType(dataType),
+		chunkPolicy,
 		nullptr,
 		&OmxFileImpl::matrixFactory);
 
@@ -592,16 +1222,69 @@ OmxIndex OmxFile::getZones() const {
 	return _impl->_zones;
 }
 
+void OmxFile::setChunkCacheBudget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(_impl->_cacheBudget._mutex);
+	_impl->_cacheBudget._limit = bytes;
+}
+
+size_t OmxFile::getChunkCacheBudget() const {
+	return _impl->_cacheBudget._limit;
+}
+
 OmxCompressionLevel OmxFile::getDefaultCompressionLevel() const {
 	_impl->requireValidHandle();
 
 	return _impl->_compressionLevel;
 }
 
+void OmxFile::setDefaultCompressionCodec(OmxCompressionCodec compressionCodec) {
+	_impl->_compressionCodec = compressionCodec;
+}
+
+OmxCompressionCodec OmxFile::getDefaultCompressionCodec() const {
+	return _impl->_compressionCodec;
+}
+
+void OmxFile::setDefaultChunkPolicy(const OmxChunkPolicy& chunkPolicy) {
+	_impl->_chunkPolicy = chunkPolicy;
+}
+
+OmxChunkPolicy OmxFile::getDefaultChunkPolicy() const {
+	return _impl->_chunkPolicy;
+}
+
 std::vector<std::string> OmxFile::getMatrixNames() const {
 	return _impl->_mats.getNames();
 }
 
+void OmxFile::readRows(OmxIndex row, const std::vector<std::string>& matrixNames, void *buffer, OmxRowLayout layout) {
+	_impl->readRows(row, matrixNames, buffer, layout, false);
+}
+
+void OmxFile::readRows(OmxIndex row, const std::vector<std::string>& matrixNames, void *buffer, OmxRowLayout layout, bool prefetchNext) {
+	_impl->readRows(row, matrixNames, buffer, layout, prefetchNext);
+}
+
+std::future<void> OmxFile::readRowAsync(const std::string& matrixName, OmxIndex row, void *rowBuffer) {
+	return _impl->ioExecutor().readRow(matrixName, row, rowBuffer);
+}
+
+std::future<void> OmxFile::readBlockAsync(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+	return _impl->ioExecutor().readBlock(matrixName, rowStart, rowCount, colStart, colCount, buffer);
+}
+
+std::future<void> OmxFile::writeRowAsync(const std::string& matrixName, OmxIndex row, const void *rowBuffer) {
+	return _impl->ioExecutor().writeRow(matrixName, row, rowBuffer);
+}
+
+std::future<void> OmxFile::writeBlockAsync(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer) {
+	return _impl->ioExecutor().writeBlock(matrixName, rowStart, rowCount, colStart, colCount, buffer);
+}
+
+void OmxFile::waitForAsync() {
+	_impl->waitForIo();
+}
+
 OmxMatrix& OmxFile::getMatrix(OmxIndex index) const {
 	_impl->requireValidHandle();
 
@@ -651,8 +1334,9 @@ OmxZonalReference& OmxFile::addZonalReference(const std::string& name, OmxDataTy
 
 	}
 
-	hid_t dataset = _impl->addH5Dataset<OmxZonalReference, OmxZonalReferenceException>(&_impl->_zonals, name, compressionLevel, 1, dims,
+	hid_t dataset = _impl->addH5Dataset<OmxZonalReference, OmxZonalReferenceException>(&_impl->_zonals, name, compressionLevel, OmxCompressionCodec::Deflate, 1, dims,
         h5Type,
+        OmxChunkPolicy::defaultPolicy(),
         nullptr,
         &OmxFileImpl::zonalReferenceFactory);
 
@@ -687,12 +1371,553 @@ OmxIndex OmxFile::getZonalReferenceCount() const {
 	return _impl->_zonals.size();
 }
 
+// raises the thread counts of a matrix for the duration of a bulk operation
+class OmxMatrixThreadsScoped {
+public:
+	OmxMatrixThreadsScoped(OmxMatrix *matrix, uint32_t threadCount)
+		: _matrix( matrix ), _compressionThreads( matrix->getCompressionThreads() ), _decompressionThreads( matrix->getDecompressionThreads() ) {
+		_matrix->setCompressionThreads(std::max(threadCount, _compressionThreads));
+		_matrix->setDecompressionThreads(std::max(threadCount, _decompressionThreads));
+	}
+
+	~OmxMatrixThreadsScoped() {
+		_matrix->setCompressionThreads(_compressionThreads);
+		_matrix->setDecompressionThreads(_decompressionThreads);
+	}
+
+private:
+	OmxMatrix *_matrix;
+	uint32_t _compressionThreads;
+	uint32_t _decompressionThreads;
+};
+
+void OmxFile::evaluate(const std::string& resultName, const OmxExpression& expression) {
+	evaluate(resultName, expression, std::max<uint32_t>(std::thread::hardware_concurrency(), 1));
+}
+
+void OmxFile::evaluate(const std::string& resultName, const OmxExpression& expression, uint32_t threadCount) {
+	_impl->requireValidHandle();
+
+	OmxExpressionProgram program(expression);
+	auto zones = _impl->_zones;
+
+	std::vector<OmxMatrix *> inputs;
+	for (auto& name : program.getMatrixNames())
+		inputs.push_back(&getMatrix(name));
+
+	std::vector<std::vector<double>> references;
+	for (auto& name : program.getReferenceNames()) {
+		auto& reference = getZonalReference(name);
+		if (reference.getDataType() == OmxDataType::String)
+			throw OmxZonalReferenceException("String zonal reference '" + name + "' can't be used in an expression.");
+
+		std::unique_ptr<uint8_t[]> values(new uint8_t[reference.getDataSize()]);
+		reference.readReference(values.get());
+
+		references.emplace_back(zones);
+		convertToDouble(reference.getDataType(), values.get(), zones, references.back().data());
+	}
+
+	auto& result = matrixNameExists(resultName) ? getMatrix(resultName) : addMatrix(resultName);
+
+	// one setting per matrix, the result may be one of the inputs
+	std::vector<OmxMatrix *> threadedMatrices(inputs);
+	threadedMatrices.push_back(&result);
+	std::sort(threadedMatrices.begin(), threadedMatrices.end());
+	threadedMatrices.erase(std::unique(threadedMatrices.begin(), threadedMatrices.end()), threadedMatrices.end());
+
+	std::vector<std::unique_ptr<OmxMatrixThreadsScoped>> threadSettings;
+	for (auto matrix : threadedMatrices)
+		threadSettings.emplace_back(new OmxMatrixThreadsScoped(matrix, threadCount));
+
+	// strips of whole chunk rows of the result, read on this thread and computed in parallel
+	size_t stripRowSize = result.getDataSize();
+	for (auto matrix : inputs)
+		stripRowSize += matrix->getDataSize();
+
+	auto chunkRows = std::max<OmxIndex>(result.getChunkDims().rows, 1);
+	auto stripRows = chunkRows * std::max<OmxIndex>(EVALUATE_STRIP_SIZE / std::max<size_t>(stripRowSize * chunkRows, 1), 1);
+	stripRows = std::min(stripRows, zones);
+
+	std::vector<std::unique_ptr<uint8_t[]>> inputStrips;
+	for (auto matrix : inputs)
+		inputStrips.emplace_back(new uint8_t[stripRows * matrix->getDataSize()]);
+	std::unique_ptr<uint8_t[]> resultStrip(new uint8_t[stripRows * result.getDataSize()]);
+
+	std::vector<const double *> referenceValues;
+	for (auto& reference : references)
+		referenceValues.push_back(reference.data());
+
+	const size_t blockSize = OmxExpressionProgram::BLOCK_SIZE;
+
+	for (OmxIndex stripStart = 0; stripStart < zones; stripStart += stripRows) {
+		auto rowCount = std::min(stripRows, zones - stripStart);
+
+		for (size_t k = 0; k < inputs.size(); k++)
+			inputs[k]->readBlock(stripStart, rowCount, 0, zones, inputStrips[k].get());
+
+		OmxIndex taskCount = std::min<OmxIndex>(rowCount, (OmxIndex)std::max<uint32_t>(threadCount, 1) * 4);
+		parallelFor(taskCount, threadCount, [&](OmxIndex task) {
+			std::vector<double> values(inputs.size() * blockSize);
+			std::vector<double> stack(std::max<size_t>(program.getStackDepth(), 1) * blockSize);
+			std::vector<const double *> matrixValues;
+			for (size_t k = 0; k < inputs.size(); k++)
+				matrixValues.push_back(values.data() + k * blockSize);
+
+			for (OmxIndex r = task * rowCount / taskCount; r < (task + 1) * rowCount / taskCount; r++) {
+				for (OmxIndex col = 0; col < zones; col += blockSize) {
+					auto count = (size_t)std::min<OmxIndex>(blockSize, zones - col);
+					auto offset = r * zones + col;
+
+					for (size_t k = 0; k < inputs.size(); k++) {
+						auto typeSize = getDataTypeSize(inputs[k]->getDataType());
+						convertToDouble(inputs[k]->getDataType(), inputStrips[k].get() + offset * typeSize, count, values.data() + k * blockSize);
+					}
+
+					program.evaluate(stripStart + r, col, count, matrixValues.data(), referenceValues.data(), stack.data());
+
+					auto resultTypeSize = getDataTypeSize(result.getDataType());
+					convertFromDouble(result.getDataType(), stack.data(), count, resultStrip.get() + offset * resultTypeSize);
+				}
+			}
+		});
+
+		result.writeBlock(stripStart, rowCount, 0, zones, resultStrip.get());
+	}
+}
+
+// transposes rows x cols values from src into dest, in square blocks small enough to stay in cache
+template <typename T>
+static void transposeTile(const T *src, OmxIndex rows, OmxIndex cols, OmxIndex srcStride, T *dest, OmxIndex destStride) {
+	for (OmxIndex rowBlock = 0; rowBlock < rows; rowBlock += TRANSPOSE_BLOCK_SIDE) {
+		auto rowEnd = std::min(rowBlock + TRANSPOSE_BLOCK_SIDE, rows);
+
+		for (OmxIndex colBlock = 0; colBlock < cols; colBlock += TRANSPOSE_BLOCK_SIDE) {
+			auto colEnd = std::min(colBlock + TRANSPOSE_BLOCK_SIDE, cols);
+
+			for (OmxIndex r = rowBlock; r < rowEnd; r++) {
+				for (OmxIndex c = colBlock; c < colEnd; c++)
+					dest[c * destStride + r] = src[r * srcStride + c];
+			}
+		}
+	}
+}
+
+static void transposeTile(size_t valueSize, const void *src, OmxIndex rows, OmxIndex cols, OmxIndex srcStride, void *dest, OmxIndex destStride) {
+	withValueSize(valueSize, [&](auto type) {
+		typedef std::remove_pointer_t<decltype(type)> T;
+		transposeTile((const T *)src, rows, cols, srcStride, (T *)dest, destStride);
+	});
+}
+
+static OmxIndex alignDown(OmxIndex count, OmxIndex alignment) {
+	return alignment > 0 && count >= alignment ? count - count % alignment : count;
+}
+
+void OmxFile::transposeMatrix(const std::string& sourceName, const std::string& destName) {
+	transposeMatrix(sourceName, destName, TRANSPOSE_MEMORY_BUDGET);
+}
+
+void OmxFile::transposeMatrix(const std::string& sourceName, const std::string& destName, size_t memoryBudget) {
+	_impl->requireValidHandle();
+
+	if (sourceName == destName)
+		throw OmxFileException("Matrix '" + sourceName + "' can't be transposed onto itself.");
+
+	auto& source = getMatrix(sourceName);
+	auto dataType = source.getDataType();
+
+	if (matrixNameExists(destName) && getMatrix(destName).getDataType() != dataType)
+		throw OmxFileException("Matrix '" + destName + "' doesn't have the data type of matrix '" + sourceName + "'.");
+
+	auto& dest = matrixNameExists(destName) ? getMatrix(destName)
+		: addMatrix(destName, dataType, source.getCompressionLevel(), source.getCompressionCodec());
+
+	auto zones = _impl->_zones;
+	auto valueSize = getDataTypeSize(dataType);
+
+	// Each band of result rows is a band of source columns. Half the budget holds the band, aligned to
+	// the result chunk rows so that every result chunk is written once; the other half holds the source
+	// tiles, read in strips aligned to the source chunk rows.
+	auto bandRows = alignDown(std::max<OmxIndex>(memoryBudget / 2 / dest.getDataSize(), 1), dest.getChunkDims().rows);
+	bandRows = std::min(bandRows, zones);
+
+	auto stripRows = alignDown(std::max<OmxIndex>(memoryBudget / 2 / (bandRows * valueSize), 1), source.getChunkDims().rows);
+	stripRows = std::min(stripRows, zones);
+
+	std::unique_ptr<uint8_t[]> band(new uint8_t[bandRows * zones * valueSize]);
+	std::unique_ptr<uint8_t[]> tile(new uint8_t[stripRows * bandRows * valueSize]);
+
+	for (OmxIndex bandStart = 0; bandStart < zones; bandStart += bandRows) {
+		auto bandCount = std::min(bandRows, zones - bandStart);
+
+		for (OmxIndex row = 0; row < zones; row += stripRows) {
+			auto rowCount = std::min(stripRows, zones - row);
+
+			source.readBlock(row, rowCount, bandStart, bandCount, tile.get());
+			transposeTile(valueSize, tile.get(), rowCount, bandCount, bandCount, band.get() + row * valueSize, zones);
+		}
+
+		dest.writeBlock(bandStart, bandCount, 0, zones, band.get());
+	}
+}
+
+// sums the listed rows of a strip that starts at source row stripStart into accumulator, which has
+// a row and a column beyond the last group that collect the zones left out
+template <typename T>
+static void aggregateRows(const T *strip, OmxIndex stripStart, const OmxIndex *rows, OmxIndex rowCount, OmxIndex zones,
+	const OmxIndex *groups, OmxIndex stride, double *accumulator) {
+	for (OmxIndex r = 0; r < rowCount; r++) {
+		const T *row = strip + (rows[r] - stripStart) * zones;
+		double *sums = accumulator + groups[rows[r]] * stride;
+
+		for (OmxIndex c = 0; c < zones; c++)
+			sums[groups[c]] += (double)row[c];
+	}
+}
+
+std::vector<double> OmxFile::aggregateMatrix(const std::string& sourceName, const std::string& mappingName) {
+	_impl->requireValidHandle();
+
+	auto& source = getMatrix(sourceName);
+	auto& mapping = getZonalReference(mappingName);
+	auto zones = _impl->_zones;
+
+	auto mappingType = mapping.getDataType();
+	if (mappingType == OmxDataType::Float || mappingType == OmxDataType::Double || mappingType == OmxDataType::String)
+		throw OmxZonalReferenceException("Zonal reference '" + mappingName + "' must hold integer group numbers.");
+
+	std::unique_ptr<uint8_t[]> mappingValues(new uint8_t[mapping.getDataSize()]);
+	mapping.readReference(mappingValues.get());
+
+	std::vector<double> groupNumbers(zones);
+	convertToDouble(mappingType, mappingValues.get(), zones, groupNumbers.data());
+
+	OmxIndex groupCount = 0;
+	for (auto group : groupNumbers) {
+		if (group >= (double)zones)
+			throw OmxZonalReferenceException("Group numbers in zonal reference '" + mappingName + "' must be below the zone count.");
+
+		if (group >= 0)
+			groupCount = std::max(groupCount, (OmxIndex)group + 1);
+	}
+
+	if (groupCount == 0)
+		throw OmxZonalReferenceException("Zonal reference '" + mappingName + "' doesn't assign any zone to a group.");
+
+	// zones without a group are summed into an extra row and column, so the inner loop needs no branch
+	auto stride = groupCount + 1;
+	std::vector<OmxIndex> groups(zones);
+	for (OmxIndex zone = 0; zone < zones; zone++)
+		groups[zone] = groupNumbers[zone] >= 0 ? (OmxIndex)groupNumbers[zone] : groupCount;
+
+	auto threadCount = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+	OmxMatrixThreadsScoped threadSettings(&source, threadCount);
+
+	auto chunkRows = std::max<OmxIndex>(source.getChunkDims().rows, 1);
+	auto stripRows = chunkRows * std::max<OmxIndex>(EVALUATE_STRIP_SIZE / std::max<size_t>(source.getDataSize() * chunkRows, 1), 1);
+	stripRows = std::min(stripRows, zones);
+
+	std::unique_ptr<uint8_t[]> strip(new uint8_t[stripRows * source.getDataSize()]);
+
+	// the zones ordered by group, so that the rows of a strip can be split between tasks at group
+	// boundaries: every task then adds into its own rows of the one accumulator
+	std::vector<OmxIndex> zonesByGroup(zones);
+	for (OmxIndex zone = 0; zone < zones; zone++)
+		zonesByGroup[zone] = zone;
+	std::stable_sort(zonesByGroup.begin(), zonesByGroup.end(), [&](OmxIndex left, OmxIndex right) { return groups[left] < groups[right]; });
+
+	std::vector<double> accumulator(stride * stride, 0.0);
+	std::vector<OmxIndex> stripRowsByGroup;
+	std::vector<OmxIndex> taskStarts;
+
+	withValueType(source.getDataType(), [&](auto type) {
+		typedef std::remove_pointer_t<decltype(type)> T;
+
+		for (OmxIndex stripStart = 0; stripStart < zones; stripStart += stripRows) {
+			auto rowCount = std::min(stripRows, zones - stripStart);
+			source.readBlock(stripStart, rowCount, 0, zones, strip.get());
+
+			stripRowsByGroup.clear();
+			for (auto zone : zonesByGroup) {
+				if (zone >= stripStart && zone < stripStart + rowCount)
+					stripRowsByGroup.push_back(zone);
+			}
+
+			// even shares of the rows, each moved forward to the start of the next group
+			auto taskCount = std::min<OmxIndex>(rowCount, threadCount);
+			taskStarts.assign(1, 0);
+			for (OmxIndex task = 1; task <= taskCount; task++) {
+				auto start = std::max(task * rowCount / taskCount, taskStarts.back());
+				while (start > 0 && start < rowCount && groups[stripRowsByGroup[start]] == groups[stripRowsByGroup[start - 1]])
+					start++;
+				taskStarts.push_back(start);
+			}
+
+			parallelFor(taskCount, threadCount, [&](OmxIndex task) {
+				aggregateRows((const T *)strip.get(), stripStart, stripRowsByGroup.data() + taskStarts[task],
+					taskStarts[task + 1] - taskStarts[task], zones, groups.data(), stride, accumulator.data());
+			});
+		}
+	});
+
+	std::vector<double> result(groupCount * groupCount);
+	for (OmxIndex row = 0; row < groupCount; row++)
+		std::copy(accumulator.begin() + row * stride, accumulator.begin() + row * stride + groupCount, result.begin() + row * groupCount);
+
+	return result;
+}
+
+void OmxFile::aggregateMatrix(const std::string& sourceName, const std::string& mappingName, OmxFile& dest, const std::string& destName) {
+	auto sums = aggregateMatrix(sourceName, mappingName);
+	auto groupCount = (OmxIndex)std::llround(std::sqrt((double)sums.size()));
+	auto zones = dest.getZones();
+
+	if (zones < groupCount)
+		throw OmxFileException("File '" + dest.getFilename() + "' has fewer zones than the " + std::to_string(groupCount) + " groups.");
+
+	auto& result = dest.matrixNameExists(destName) ? dest.getMatrix(destName) : dest.addMatrix(destName, OmxDataType::Double);
+
+	// groups beyond the largest one are left at zero
+	std::vector<double> values(zones * zones, 0.0);
+	for (OmxIndex row = 0; row < groupCount; row++)
+		std::copy(sums.begin() + row * groupCount, sums.begin() + (row + 1) * groupCount, values.begin() + row * zones);
+
+	std::unique_ptr<uint8_t[]> buffer(new uint8_t[zones * result.getDataSize()]);
+	convertFromDouble(result.getDataType(), values.data(), zones * zones, buffer.get());
+	result.writeMatrix(buffer.get());
+}
+
+// a loop of indexed loads the compiler can turn into vector gathers
+template <typename T>
+static void gatherColumns(const T *src, const OmxIndex *columns, OmxIndex count, T *dest) {
+	for (OmxIndex i = 0; i < count; i++)
+		dest[i] = src[columns[i]];
+}
+
+void OmxFile::extractSubMatrix(const std::string& sourceName, const std::vector<OmxIndex>& zones, OmxFile& dest, const std::string& destName) {
+	_impl->requireValidHandle();
+
+	auto& source = getMatrix(sourceName);
+	auto sourceZones = _impl->_zones;
+	auto zoneCount = (OmxIndex)zones.size();
+
+	if (dest.getZones() != zoneCount)
+		throw OmxFileException("File '" + dest.getFilename() + "' must have one zone for each of the " + std::to_string(zoneCount) + " extracted zones.");
+
+	for (auto zone : zones) {
+		if (zone >= sourceZones)
+			throw std::out_of_range("Zone index " + std::to_string(zone) + " was out of the acceptable range.");
+	}
+
+	auto dataType = source.getDataType();
+	if (dest.matrixNameExists(destName) && dest.getMatrix(destName).getDataType() != dataType)
+		throw OmxFileException("Matrix '" + destName + "' doesn't have the data type of matrix '" + sourceName + "'.");
+
+	auto& result = dest.matrixNameExists(destName) ? dest.getMatrix(destName)
+		: dest.addMatrix(destName, dataType, source.getCompressionLevel(), source.getCompressionCodec());
+
+	auto threadCount = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+	OmxMatrixThreadsScoped sourceThreads(&source, threadCount);
+	OmxMatrixThreadsScoped resultThreads(&result, threadCount);
+
+	// result strips of whole chunk rows, so that each result chunk is compressed and written once
+	auto sourceRowSize = source.getDataSize();
+	auto resultRowSize = result.getDataSize();
+	auto sourceChunkRows = std::max<OmxIndex>(source.getChunkDims().rows, 1);
+	auto resultChunkRows = std::max<OmxIndex>(result.getChunkDims().rows, 1);
+	auto stripRows = resultChunkRows * std::max<OmxIndex>(EXTRACT_STRIP_SIZE / std::max<size_t>(resultRowSize * resultChunkRows, 1), 1);
+	stripRows = std::min(stripRows, zoneCount);
+	auto runChunkRows = std::max<OmxIndex>(EXTRACT_STRIP_SIZE / (sourceRowSize * sourceChunkRows), 1);
+
+	std::unique_ptr<uint8_t[]> strip(new uint8_t[stripRows * resultRowSize]);
+	std::unique_ptr<uint8_t[]> run(new uint8_t[std::min(runChunkRows * sourceChunkRows, sourceZones) * sourceRowSize]);
+
+	withValueSize(getDataTypeSize(dataType), [&](auto type) {
+		typedef std::remove_pointer_t<decltype(type)> T;
+
+		for (OmxIndex stripStart = 0; stripStart < zoneCount; stripStart += stripRows) {
+			auto rowCount = std::min(stripRows, zoneCount - stripStart);
+
+			// only the source chunk rows holding selected rows are read, each once and in file order
+			std::vector<OmxIndex> chunkRows;
+			for (OmxIndex i = 0; i < rowCount; i++)
+				chunkRows.push_back(zones[stripStart + i] / sourceChunkRows);
+			std::sort(chunkRows.begin(), chunkRows.end());
+			chunkRows.erase(std::unique(chunkRows.begin(), chunkRows.end()), chunkRows.end());
+
+			for (size_t k = 0; k < chunkRows.size();) {
+				// consecutive chunk rows are read together
+				auto end = k + 1;
+				while (end < chunkRows.size() && chunkRows[end] == chunkRows[end - 1] + 1 && end - k < runChunkRows)
+					end++;
+
+				auto runStart = chunkRows[k] * sourceChunkRows;
+				auto runEnd = std::min((chunkRows[end - 1] + 1) * sourceChunkRows, sourceZones);
+				source.readBlock(runStart, runEnd - runStart, 0, sourceZones, run.get());
+
+				for (OmxIndex i = 0; i < rowCount; i++) {
+					auto row = zones[stripStart + i];
+					if (row >= runStart && row < runEnd) {
+						gatherColumns((const T *)(run.get() + (row - runStart) * sourceRowSize), zones.data(), zoneCount,
+							(T *)(strip.get() + i * resultRowSize));
+					}
+				}
+
+				k = end;
+			}
+
+			result.writeBlock(stripStart, rowCount, 0, zoneCount, strip.get());
+		}
+	});
+}
+
+void OmxFile::copyMatrixFrom(OmxFile& other, const std::string& name) {
+	copyMatrixFrom(other, name, name);
+}
+
+void OmxFile::copyMatrixFrom(OmxFile& other, const std::string& name, const std::string& newName) {
+	_impl->copyMatrixFrom(*other._impl, name, newName);
+}
+
+void OmxFile::copyMatricesFrom(OmxFile& other, const std::vector<std::string>& names) {
+	for (auto& name : names)
+		_impl->copyMatrixFrom(*other._impl, name, name);
+}
+
+OmxMatrixComparison OmxFile::compareMatrix(const std::string& name, OmxFile& other, const std::string& otherName, const OmxCompareOptions& options) {
+	_impl->requireValidHandle();
+
+	auto& matrix = getMatrix(name);
+	auto& otherMatrix = other.getMatrix(otherName);
+	auto zones = _impl->_zones;
+
+	if (other.getZones() != zones)
+		throw OmxFileException("File '" + other.getFilename() + "' doesn't have the " + std::to_string(zones) + " zones of file '" + getFilename() + "'.");
+
+	auto threadCount = std::max<uint32_t>(options.threadCount, 1);
+	OmxMatrixThreadsScoped threadSettings(&matrix, threadCount);
+	std::unique_ptr<OmxMatrixThreadsScoped> otherThreadSettings(&otherMatrix != &matrix ? new OmxMatrixThreadsScoped(&otherMatrix, threadCount) : nullptr);
+
+	OmxMatrixComparison result{ name, 0, 0.0, 0.0, std::vector<OmxCellDifference>(), 0, true };
+
+	// strips of whole chunk rows; when both store chunks alike, chunk rows stored identically are skipped
+	bool isSameStorage = matrix.hasSameChunkStorage(otherMatrix);
+	auto chunkRows = std::max<OmxIndex>(matrix.getChunkDims().rows, 1);
+	auto stripRowSize = matrix.getDataSize() + otherMatrix.getDataSize();
+	auto stripRows = chunkRows * std::max<OmxIndex>(COMPARE_STRIP_SIZE / std::max<size_t>(stripRowSize * chunkRows, 1), 1);
+	stripRows = std::min(stripRows, zones);
+
+	std::unique_ptr<uint8_t[]> strip(new uint8_t[stripRows * matrix.getDataSize()]);
+	std::unique_ptr<uint8_t[]> otherStrip(new uint8_t[stripRows * otherMatrix.getDataSize()]);
+	auto typeSize = getDataTypeSize(matrix.getDataType());
+	auto otherTypeSize = getDataTypeSize(otherMatrix.getDataType());
+
+	OmxIndex taskCount = std::min<OmxIndex>(stripRows, (OmxIndex)threadCount * 4);
+	std::vector<OmxCellComparer> comparers(taskCount, OmxCellComparer(options));
+	const size_t blockSize = OmxExpressionProgram::BLOCK_SIZE;
+
+	for (OmxIndex stripStart = 0; stripStart < zones; stripStart += stripRows) {
+		auto stripEnd = std::min(stripStart + stripRows, zones);
+
+		// the runs of rows that have to be decompressed and compared
+		std::vector<std::pair<OmxIndex, OmxIndex>> runs;
+		for (OmxIndex row = stripStart; row < stripEnd; row += chunkRows) {
+			auto rowEnd = std::min(row + chunkRows, stripEnd);
+
+			if (isSameStorage && matrix.isChunkRowStorageEqual(otherMatrix, row / chunkRows))
+				result.identicalChunkRows++;
+			else if (!runs.empty() && runs.back().second == row)
+				runs.back().second = rowEnd;
+			else
+				runs.emplace_back(row, rowEnd);
+		}
+
+		for (auto& run : runs) {
+			auto rowCount = run.second - run.first;
+			auto offset = run.first - stripStart;
+
+			matrix.readBlock(run.first, rowCount, 0, zones, strip.get() + offset * matrix.getDataSize());
+			otherMatrix.readBlock(run.first, rowCount, 0, zones, otherStrip.get() + offset * otherMatrix.getDataSize());
+
+			auto runTasks = std::min(taskCount, rowCount);
+			parallelFor(runTasks, threadCount, [&](OmxIndex task) {
+				std::vector<double> values(blockSize), otherValues(blockSize);
+
+				for (OmxIndex r = task * rowCount / runTasks; r < (task + 1) * rowCount / runTasks; r++) {
+					for (OmxIndex col = 0; col < zones; col += blockSize) {
+						auto count = (size_t)std::min<OmxIndex>(blockSize, zones - col);
+						auto cell = (offset + r) * zones + col;
+
+						convertToDouble(matrix.getDataType(), strip.get() + cell * typeSize, count, values.data());
+						convertToDouble(otherMatrix.getDataType(), otherStrip.get() + cell * otherTypeSize, count, otherValues.data());
+						comparers[task].compare(run.first + r, col, count, values.data(), otherValues.data());
+					}
+				}
+			});
+		}
+
+		if (options.stopAtFirstMismatch && stripEnd < zones) {
+			bool hasMismatch = false;
+			for (auto& comparer : comparers)
+				hasMismatch = hasMismatch || comparer.getMismatchCount() > 0;
+
+			if (hasMismatch) {
+				result.isComplete = false;
+				break;
+			}
+		}
+	}
+
+	for (size_t task = 1; task < comparers.size(); task++)
+		comparers[0].merge(comparers[task]);
+	comparers[0].report(&result);
+
+	return result;
+}
+
+OmxFileComparison OmxFile::compare(OmxFile& other) {
+	return compare(other, OmxCompareOptions());
+}
+
+OmxFileComparison OmxFile::compare(OmxFile& other, const OmxCompareOptions& options) {
+	_impl->requireValidHandle();
+
+	OmxFileComparison result{ std::vector<OmxMatrixComparison>(), std::vector<std::string>(), std::vector<std::string>(), true };
+
+	for (auto& name : getMatrixNames()) {
+		if (!other.matrixNameExists(name)) {
+			result.onlyInFile.push_back(name);
+			continue;
+		}
+
+		if (!result.isComplete)
+			continue;
+
+		result.matrices.push_back(compareMatrix(name, other, name, options));
+
+		if (options.stopAtFirstMismatch && result.matrices.back().mismatchCount > 0)
+			result.isComplete = false;
+	}
+
+	for (auto& name : other.getMatrixNames()) {
+		if (!matrixNameExists(name))
+			result.onlyInOther.push_back(name);
+	}
+
+	return result;
+}
+
 OmxAttributeCollection& OmxFile::attributes() const {
 	return *_impl->_attributes;
 }
 
-void OmxFile::vacuum() {
-	std::runtime_error("Not implemented.");
+size_t OmxFile::vacuum() {
+	return vacuum(true);
+}
+
+size_t OmxFile::vacuum(bool copyRawChunks) {
+	return _impl->vacuum(copyRawChunks);
 }
 
 void OmxFile::close() {
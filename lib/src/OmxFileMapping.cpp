@@ -0,0 +1,110 @@
+#include "OmxFileMapping.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace omx {
+
+#if defined(_WIN32)
+
+OmxFileMapping::OmxFileMapping()
+	: _data( nullptr ), _size( 0 ), _view( nullptr ), _viewSize( 0 ), _fileHandle( INVALID_HANDLE_VALUE ), _mappingHandle( nullptr ) {
+}
+
+void OmxFileMapping::map(const std::string& path, uint64_t offset, size_t size) {
+	unmap();
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	uint64_t viewOffset = offset - offset % info.dwAllocationGranularity;
+
+	_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_fileHandle == INVALID_HANDLE_VALUE)
+		throw OmxException("Unable to open '" + path + "' for mapping.");
+
+	_mappingHandle = CreateFileMappingA(_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!_mappingHandle) {
+		unmap();
+		throw OmxException("Unable to map '" + path + "'.");
+	}
+
+	_viewSize = (size_t)(offset - viewOffset) + size;
+	_view = MapViewOfFile(_mappingHandle, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xffffffff), _viewSize);
+	if (!_view) {
+		unmap();
+		throw OmxException("Unable to map '" + path + "'.");
+	}
+
+	_data = (const uint8_t *)_view + (offset - viewOffset);
+	_size = size;
+}
+
+void OmxFileMapping::unmap() {
+	if (_view)
+		UnmapViewOfFile(_view);
+	if (_mappingHandle)
+		CloseHandle(_mappingHandle);
+	if (_fileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(_fileHandle);
+
+	_view = nullptr;
+	_mappingHandle = nullptr;
+	_fileHandle = INVALID_HANDLE_VALUE;
+	_data = nullptr;
+	_size = 0;
+	_viewSize = 0;
+}
+
+#else
+
+OmxFileMapping::OmxFileMapping()
+	: _data( nullptr ), _size( 0 ), _view( nullptr ), _viewSize( 0 ) {
+}
+
+void OmxFileMapping::map(const std::string& path, uint64_t offset, size_t size) {
+	unmap();
+
+	uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+	uint64_t viewOffset = offset - offset % pageSize;
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw OmxException("Unable to open '" + path + "' for mapping.");
+
+	// the mapping keeps its own reference to the file
+	size_t viewSize = (size_t)(offset - viewOffset) + size;
+	void *view = mmap(nullptr, viewSize, PROT_READ, MAP_SHARED, fd, (off_t)viewOffset);
+	::close(fd);
+
+	if (view == MAP_FAILED)
+		throw OmxException("Unable to map '" + path + "'.");
+
+	_view = view;
+	_viewSize = viewSize;
+	_data = (const uint8_t *)view + (offset - viewOffset);
+	_size = size;
+}
+
+void OmxFileMapping::unmap() {
+	if (_view)
+		munmap(_view, _viewSize);
+
+	_view = nullptr;
+	_data = nullptr;
+	_size = 0;
+	_viewSize = 0;
+}
+
+#endif
+
+OmxFileMapping::~OmxFileMapping() {
+	unmap();
+}
+
+}
@@ -0,0 +1,41 @@
+#ifndef OMXLIB_OMX_FILE_MAPPING_HPP
+#define OMXLIB_OMX_FILE_MAPPING_HPP
+
+#include "../include/OmxCommon.hpp"
+
+#include <string>
+#include <cstdint>
+
+namespace omx {
+
+// A read only view of a byte range of a file, shared with every other process mapping the same file.
+class OmxFileMapping {
+public:
+	OmxFileMapping();
+	OmxFileMapping(const OmxFileMapping&) = delete;
+	OmxFileMapping& operator=(const OmxFileMapping&) = delete;
+	~OmxFileMapping();
+
+	void map(const std::string& path, uint64_t offset, size_t size);
+	void unmap();
+
+	bool isMapped() const { return _data != nullptr; }
+	const uint8_t *data() const { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	const uint8_t *_data;
+	size_t _size;
+
+	// the mapped view starts at the page boundary before the requested offset
+	void *_view;
+	size_t _viewSize;
+
+#if defined(_WIN32)
+	void *_fileHandle;
+	void *_mappingHandle;
+#endif
+};
+
+}
+#endif
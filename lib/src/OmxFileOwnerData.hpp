@@ -2,11 +2,21 @@
 #define OMX_FILE_OWNER_DATA_HPP
 
 #include <string>
+#include <functional>
 
 namespace omx {
+struct OmxChunkCacheBudget;
+
+// the dataset handle is owned by the object created from this data
 struct OmxFileOwnerData {
 	hid_t _handle;
 	hid_t _dataset;
+	std::string _path;
+	OmxChunkCacheBudget *_cacheBudget;
+
+	// waits for the file's readRows() prefetch and queued asynchronous requests, which use the
+	// dataset handles of its matrices
+	std::function<void()> _waitForBackgroundReads;
 };
 }
 
@@ -0,0 +1,217 @@
+#include "OmxIoExecutor.hpp"
+
+#include "../include/OmxMatrix.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace omx {
+
+// the largest block that adjacent row reads are merged into
+static const size_t MAX_MERGED_READ_SIZE = 16 * 1024 * 1024;
+
+OmxIoExecutor::OmxIoExecutor(MatrixFn_t matrixFn) : _matrixFn( matrixFn ), _isBusy( false ), _isStopping( false ) {
+	_thread = std::thread([this]() { run(); });
+}
+
+OmxIoExecutor::~OmxIoExecutor() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_isStopping = true;
+	}
+
+	_hasWork.notify_one();
+	_thread.join();
+}
+
+std::future<void> OmxIoExecutor::readBlock(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+	return enqueue(Kind::ReadBlock, matrixName, rowStart, rowCount, colStart, colCount, buffer);
+}
+
+std::future<void> OmxIoExecutor::writeBlock(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer) {
+	return enqueue(Kind::WriteBlock, matrixName, rowStart, rowCount, colStart, colCount, const_cast<void *>(buffer));
+}
+
+std::future<void> OmxIoExecutor::readRow(const std::string& matrixName, OmxIndex row, void *buffer) {
+	return enqueue(Kind::ReadRow, matrixName, row, 1, 0, 0, buffer);
+}
+
+std::future<void> OmxIoExecutor::writeRow(const std::string& matrixName, OmxIndex row, const void *buffer) {
+	return enqueue(Kind::WriteRow, matrixName, row, 1, 0, 0, const_cast<void *>(buffer));
+}
+
+void OmxIoExecutor::drain() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_isIdle.wait(lock, [this]() { return _queue.empty() && !_isBusy; });
+}
+
+std::future<void> OmxIoExecutor::enqueue(Kind kind, const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount,
+	OmxIndex colStart, OmxIndex colCount, void *buffer) {
+	std::future<void> future;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queue.push_back(Request{ kind, matrixName, rowStart, rowCount, colStart, colCount, buffer, std::promise<void>() });
+		future = _queue.back()._promise.get_future();
+	}
+
+	_hasWork.notify_one();
+	return future;
+}
+
+void OmxIoExecutor::run() {
+	std::vector<Request> batch;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_hasWork.wait(lock, [this]() { return !_queue.empty() || _isStopping; });
+
+			if (_queue.empty())
+				return;
+
+			batch.swap(_queue);
+			_isBusy = true;
+		}
+
+		issueBatch(batch);
+		batch.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_isBusy = false;
+		}
+
+		_isIdle.notify_all();
+	}
+}
+
+// Reads may be issued in any order among themselves, and so may writes of whole rows (the writes of one
+// row keep their order). Runs of either are sorted; block writes stay where they are.
+void OmxIoExecutor::issueBatch(std::vector<Request>& batch) {
+	auto isRead = [](const Request& request) { return request._kind == Kind::ReadRow || request._kind == Kind::ReadBlock; };
+
+	for (size_t i = 0; i < batch.size();) {
+		auto end = i + 1;
+
+		if (isRead(batch[i])) {
+			while (end < batch.size() && isRead(batch[end]))
+				end++;
+
+			issueReads(batch.data() + i, batch.data() + end);
+		}
+		else if (batch[i]._kind == Kind::WriteRow) {
+			while (end < batch.size() && batch[end]._kind == Kind::WriteRow)
+				end++;
+
+			issueRowWrites(batch.data() + i, batch.data() + end);
+		}
+		else {
+			issue(batch[i]);
+		}
+
+		i = end;
+	}
+}
+
+static bool isBefore(const std::string& matrixName, OmxIndex row, const std::string& otherMatrixName, OmxIndex otherRow) {
+	int order = matrixName.compare(otherMatrixName);
+	return order < 0 || (order == 0 && row < otherRow);
+}
+
+void OmxIoExecutor::issueReads(Request *begin, Request *end) {
+	std::stable_sort(begin, end, [](const Request& left, const Request& right) {
+		return isBefore(left._matrixName, left._rowStart, right._matrixName, right._rowStart);
+	});
+
+	std::vector<uint8_t> block;
+
+	for (auto request = begin; request < end;) {
+		if (request->_kind != Kind::ReadRow) {
+			issue(*request++);
+			continue;
+		}
+
+		OmxMatrix *matrix = nullptr;
+		try {
+			matrix = _matrixFn(request->_matrixName);
+		}
+		catch (...) {
+			request->_promise.set_exception(std::current_exception());
+			request++;
+			continue;
+		}
+
+		// adjacent rows of the same matrix, repeated rows included, as far as they fit a merged read
+		auto rowSize = matrix->getDataSize();
+		auto maxRows = std::max<OmxIndex>(MAX_MERGED_READ_SIZE / std::max<size_t>(rowSize, 1), 1);
+		auto rowStart = request->_rowStart;
+		auto rowEnd = rowStart + 1;
+		auto runEnd = request + 1;
+
+		while (runEnd < end && runEnd->_kind == Kind::ReadRow && runEnd->_matrixName == request->_matrixName
+			&& runEnd->_rowStart <= rowEnd && runEnd->_rowStart < matrix->getZones() && runEnd->_rowStart - rowStart < maxRows) {
+			rowEnd = std::max(rowEnd, runEnd->_rowStart + 1);
+			runEnd++;
+		}
+
+		if (runEnd - request == 1 || rowStart >= matrix->getZones()) {
+			issue(*request++);
+			continue;
+		}
+
+		try {
+			block.resize((rowEnd - rowStart) * rowSize);
+			matrix->readBlock(rowStart, rowEnd - rowStart, 0, matrix->getZones(), block.data());
+
+			for (auto r = request; r < runEnd; r++) {
+				std::memcpy(r->_buffer, block.data() + (r->_rowStart - rowStart) * rowSize, rowSize);
+				r->_promise.set_value();
+			}
+		}
+		catch (...) {
+			for (auto r = request; r < runEnd; r++)
+				r->_promise.set_exception(std::current_exception());
+		}
+
+		request = runEnd;
+	}
+}
+
+// the matrices collect rows written in order into whole chunk rows before they are stored
+void OmxIoExecutor::issueRowWrites(Request *begin, Request *end) {
+	std::stable_sort(begin, end, [](const Request& left, const Request& right) {
+		return isBefore(left._matrixName, left._rowStart, right._matrixName, right._rowStart);
+	});
+
+	for (auto request = begin; request < end; request++)
+		issue(*request);
+}
+
+void OmxIoExecutor::issue(Request& request) {
+	try {
+		auto matrix = _matrixFn(request._matrixName);
+
+		switch (request._kind) {
+		case Kind::ReadRow:
+			matrix->readRow(request._rowStart, request._buffer);
+			break;
+		case Kind::ReadBlock:
+			matrix->readBlock(request._rowStart, request._rowCount, request._colStart, request._colCount, request._buffer);
+			break;
+		case Kind::WriteRow:
+			matrix->writeRow(request._rowStart, request._buffer);
+			break;
+		case Kind::WriteBlock:
+			matrix->writeBlock(request._rowStart, request._rowCount, request._colStart, request._colCount, request._buffer);
+			break;
+		}
+
+		request._promise.set_value();
+	}
+	catch (...) {
+		request._promise.set_exception(std::current_exception());
+	}
+}
+
+}
@@ -0,0 +1,81 @@
+#ifndef OMXLIB_OMX_IO_EXECUTOR_HPP
+#define OMXLIB_OMX_IO_EXECUTOR_HPP
+
+#include "../include/OmxCommon.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace omx {
+
+class OmxMatrix;
+
+// A thread that makes every HDF5 call for the queued matrix reads and writes of a file. The requests that
+// queue up while it is busy are issued as a batch: ordered by matrix and row within each run of reads and
+// each run of row writes, and with runs of adjacent whole row reads merged into single block reads.
+class OmxIoExecutor {
+public:
+	typedef std::function<OmxMatrix *(const std::string&)> MatrixFn_t;
+
+	// matrixFn looks matrices up by name, on the I/O thread
+	OmxIoExecutor(MatrixFn_t matrixFn);
+	OmxIoExecutor(const OmxIoExecutor&) = delete;
+	OmxIoExecutor & operator=(const OmxIoExecutor&) = delete;
+
+	// issues the requests still queued before the thread ends
+	~OmxIoExecutor();
+
+	std::future<void> readBlock(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer);
+	std::future<void> writeBlock(const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer);
+
+	// whole rows, the ones that are reordered and merged
+	std::future<void> readRow(const std::string& matrixName, OmxIndex row, void *buffer);
+	std::future<void> writeRow(const std::string& matrixName, OmxIndex row, const void *buffer);
+
+	// waits until every request queued so far has completed
+	void drain();
+
+private:
+	enum class Kind {
+		ReadRow, ReadBlock, WriteRow, WriteBlock
+	};
+
+	struct Request {
+		Kind _kind;
+		std::string _matrixName;
+		OmxIndex _rowStart;
+		OmxIndex _rowCount;
+		OmxIndex _colStart;
+		OmxIndex _colCount;
+		void *_buffer;
+		std::promise<void> _promise;
+	};
+
+	std::future<void> enqueue(Kind kind, const std::string& matrixName, OmxIndex rowStart, OmxIndex rowCount,
+		OmxIndex colStart, OmxIndex colCount, void *buffer);
+
+	void run();
+	void issueBatch(std::vector<Request>& batch);
+	void issueReads(Request *begin, Request *end);
+	void issueRowWrites(Request *begin, Request *end);
+	void issue(Request& request);
+
+	MatrixFn_t _matrixFn;
+
+	std::mutex _mutex;
+	std::condition_variable _hasWork;
+	std::condition_variable _isIdle;
+	std::vector<Request> _queue;
+	bool _isBusy;
+	bool _isStopping;
+
+	std::thread _thread;
+};
+
+}
+#endif
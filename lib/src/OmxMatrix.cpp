@@ -1,77 +1,1122 @@
 #include "../include/OmxMatrix.hpp"
 
 #include "OmxH5Common.hpp"
+#include "H5Scoped.hpp"
 #include "OmxFileOwnerData.hpp"
 #include "OmxAttributeOwnerData.hpp"
+#include "OmxParallel.hpp"
+#include "OmxChunkCodec.hpp"
+#include "OmxChunkCache.hpp"
+#include "OmxFileMapping.hpp"
+#include "OmxDataConversion.hpp"
 
 #include <stdexcept>
 #include <map>
+#include <algorithm>
+#include <atomic>
 
 #include <cstring>
+#include <functional>
+#include <limits>
+#include <thread>
 
 #include <hdf5.h>
 #include <hdf5_hl.h>
 
 namespace omx {
 
+// threaded whole-matrix transfers hand each thread at least this much data per call
+static const size_t MIN_PARALLEL_TRANSFER_SIZE = 4 * 1024 * 1024;
+
+#define HDF5_ATTR_OMX_STATS_SUM			"OMX_STATS_SUM"
+#define HDF5_ATTR_OMX_STATS_MIN			"OMX_STATS_MIN"
+#define HDF5_ATTR_OMX_STATS_MAX			"OMX_STATS_MAX"
+#define HDF5_ATTR_OMX_STATS_NONZERO		"OMX_STATS_NONZERO"
+#define HDF5_ATTR_OMX_STATS_NAN			"OMX_STATS_NAN"
+
+static const char *STATS_ATTRIBUTE_NAMES[] = {
+	HDF5_ATTR_OMX_STATS_SUM, HDF5_ATTR_OMX_STATS_MIN, HDF5_ATTR_OMX_STATS_MAX, HDF5_ATTR_OMX_STATS_NONZERO, HDF5_ATTR_OMX_STATS_NAN
+};
+
+// adds count values to stats; NaN values are only counted
+template <typename T>
+static void accumulateStats(const T *values, size_t count, OmxMatrixStats& stats) {
+	double sum = 0.0;
+	double minValue = stats.min;
+	double maxValue = stats.max;
+	uint64_t nonZeroCount = 0;
+	uint64_t nanCount = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		double value = (double)values[i];
+
+		if (value != value) {
+			nanCount++;
+			continue;
+		}
+
+		sum += value;
+		nonZeroCount += value != 0.0;
+		minValue = value < minValue ? value : minValue;
+		maxValue = value > maxValue ? value : maxValue;
+	}
+
+	stats.sum += sum;
+	stats.min = minValue;
+	stats.max = maxValue;
+	stats.nonZeroCount += nonZeroCount;
+	stats.nanCount += nanCount;
+}
+
+static OmxMatrixStats emptyStats() {
+	return OmxMatrixStats{ 0.0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), 0, 0 };
+}
+
+// reads the stored bytes of the chunk at (row, col) with H5Dread_chunk, none when it was never written
+static void readStoredChunk(hid_t dataset, OmxIndex row, OmxIndex col, std::vector<uint8_t> *chunk, uint32_t *filterMask) {
+	hsize_t offset[2] = { row, col };
+	hsize_t storageSize = 0;
+	haddr_t address = HADDR_UNDEF;
+	unsigned int storedFilterMask = 0;
+
+	// chunks that were never written have no address and a size of zero
+	if (H5Dget_chunk_info_by_coord(dataset, offset, &storedFilterMask, &address, &storageSize) < 0)
+		throw OmxMatrixException("Unable to locate chunk of matrix.");
+
+	if (address == HADDR_UNDEF)
+		storageSize = 0;
+
+	chunk->resize(storageSize);
+	*filterMask = 0;
+
+	if (storageSize > 0 && H5Dread_chunk(dataset, H5P_DEFAULT, offset, filterMask, chunk->data()) < 0)
+		throw OmxMatrixException("Unable to read compressed chunk of matrix.");
+}
+
+// accumulators per reduction in summarizeRow()
+static const OmxIndex SUMMARY_LANES = 4;
+
+// Adds a row to the column sums and extremes and returns its sum. Each lane accumulates every
+// SUMMARY_LANES-th value: with a single accumulator every addition and comparison waits for the one
+// before, which keeps the compiler from vectorizing or overlapping them without fast-math.
+template <typename T>
+static double summarizeRow(const T *values, OmxIndex count, double *columns, double *minValue, double *maxValue) {
+	double sums[SUMMARY_LANES], mins[SUMMARY_LANES], maxs[SUMMARY_LANES];
+	for (OmxIndex l = 0; l < SUMMARY_LANES; l++) {
+		sums[l] = 0.0;
+		mins[l] = *minValue;
+		maxs[l] = *maxValue;
+	}
+
+	OmxIndex c = 0;
+	for (; c + SUMMARY_LANES <= count; c += SUMMARY_LANES) {
+		for (OmxIndex l = 0; l < SUMMARY_LANES; l++) {
+			double value = (double)values[c + l];
+			sums[l] += value;
+			columns[c + l] += value;
+			mins[l] = value < mins[l] ? value : mins[l];
+			maxs[l] = value > maxs[l] ? value : maxs[l];
+		}
+	}
+
+	for (; c < count; c++) {
+		double value = (double)values[c];
+		sums[0] += value;
+		columns[c] += value;
+		mins[0] = value < mins[0] ? value : mins[0];
+		maxs[0] = value > maxs[0] ? value : maxs[0];
+	}
+
+	double sum = 0.0;
+	for (OmxIndex l = 0; l < SUMMARY_LANES; l++) {
+		sum += sums[l];
+		*minValue = mins[l] < *minValue ? mins[l] : *minValue;
+		*maxValue = maxs[l] > *maxValue ? maxs[l] : *maxValue;
+	}
+
+	return sum;
+}
+
+// whole matrix passes read strips of whole chunk rows of about this size
+static const size_t STREAM_STRIP_SIZE = 64 * 1024 * 1024;
+
+// chunks compressed per compression thread before the batch is handed to HDF5
+static const OmxIndex CHUNKS_PER_COMPRESSION_THREAD = 4;
+
+// HDF5's own chunk cache size, used for random access
+static const size_t DEFAULT_CHUNK_CACHE_SIZE = 1024 * 1024;
+
+// the largest chunk cache an access hint asks for; hints needing more fall back to the default
+static const size_t MAX_HINTED_CHUNK_CACHE_SIZE = 256 * 1024 * 1024;
+
+// rows buffered by writeRow() or decoded ahead by readRow(); taller chunk shapes go straight to HDF5
+static const size_t MAX_ROW_WINDOW_SIZE = 64 * 1024 * 1024;
+
+// copies the requested columns of a rowCount x blockCols block into column-major output
+template <typename T>
+static void scatterColumns(const T *block, OmxIndex rowCount, OmxIndex blockCols,
+						   const std::vector<std::pair<OmxIndex, OmxIndex>>& columns, T *output, OmxIndex outputRowStart, OmxIndex zones) {
+	for (const auto& c : columns) {
+		auto src = block + c.second;
+		auto dst = output + c.first * zones + outputRowStart;
+
+		for (OmxIndex r = 0; r < rowCount; r++)
+			dst[r] = src[r * blockCols];
+	}
+}
+
 class OmxMatrix::OmxMatrixImpl {
 public:
-	OmxMatrixImpl(OmxIndex zones, OmxDataType dataType, const std::string& name, OmxCompressionLevel compressionLevel, hid_t dataset, size_t sizeOfDataType) :
+	OmxMatrixImpl(OmxIndex zones, OmxDataType dataType, const std::string& name, OmxCompressionLevel compressionLevel, const OmxFileOwnerData *ownerData, size_t sizeOfDataType) :
 								_zones( zones ),
 								_dataType( dataType ),
 								_name(name),
 								_compressionLevel( compressionLevel ),
-								_dataset( dataset ),
+								_compressionCodec( OmxCompressionCodec::Deflate ),
+								_fileHandle( ownerData->_handle ),
+								_dataset( ownerData->_dataset ),
+								_path( ownerData->_path ),
+								_cacheBudget( ownerData->_cacheBudget ),
+								_waitForBackgroundReads( ownerData->_waitForBackgroundReads ),
+								_readerCount( std::make_shared<std::atomic<uint32_t>>(0) ),
 								_sizeOfDataType{ sizeOfDataType },
 								_attributes(nullptr) {
 		_memspace = -1;
+		_stats = emptyStats();
+		_statsRowCount = 0;
+		_isStatsValid = true;
+		_isStatsDirty = false;
 		_dataspace = -1;
+		_pendingRowStart = 0;
+		_pendingRowCount = 0;
+		_writeGeneration = 0;
+		_compressionThreads = 1;
+		_decompressionThreads = 1;
+		_cachedRowCapacity = 0;
+		_cachedRowStart = 0;
+		_cachedRowCount = 0;
+
+		_accessHint = OmxAccessPattern::Random;
+		_requestedCacheSize = 0;
+		_grantedCacheSize = 0;
+
+		readStorageLayout();
+
+		if (_cacheBudget && _cacheBudget->isLimited())
+			configureChunkCache();
+
+		// attributes are addressed by path so they survive the dataset being reopened
+		OmxAttributeOwnerData attributeOwnerData{ _fileHandle, _path };
+		_attributes.reset(new OmxAttributeCollection(&attributeOwnerData));
+
+		_isClosed = false;
+	}
+
+	// OmxFile flushes its matrices on close() and reports failures, this is only a last resort
+	~OmxMatrixImpl() {
+		try {
+			flushPendingRows();
+			persistStats();
+		}
+		catch (...) {
+		}
+
+		close();
+	}
+
+	void readStorageLayout() {
+		hsize_t chunkDims[2] = { 1, _zones };
+		_isChunked = false;
+		_filters = OmxChunkFilters{ false, OmxChunkCompressor::None, 0, -1, 0, -1 };
+
+		H5PlistScoped plist(H5Dget_create_plist(_dataset));
+		if (plist >= 0 && H5Pget_layout(plist) == H5D_CHUNKED) {
+			if (H5Pget_chunk(plist, 2, chunkDims) == 2) {
+				_isChunked = true;
+				_filters = getChunkFilters(plist);
+			}
+			else {
+				chunkDims[0] = 1;
+				chunkDims[1] = _zones;
+			}
+		}
+
+		_chunkDims[0] = chunkDims[0];
+		_chunkDims[1] = chunkDims[1];
+
+		if (_filters.isCompressed())
+			_compressionLevel = getOmxCompressionLevelFromH5(std::min<uint32_t>(_filters.level, 9));
+
+		_compressionCodec = getChunkCompressionCodec(_filters);
+	}
+
+	bool useDirectChunkWrites(uint32_t threadCount) const {
+		return threadCount > 1 && _isChunked && _filters.isCompressed() && canCodeChunksDirectly(_filters);
+	}
+
+	bool isChunkRowAligned(OmxIndex rowStart, OmxIndex rowCount) const {
+		return rowStart % _chunkDims[0] == 0 && (rowCount % _chunkDims[0] == 0 || rowStart + rowCount == _zones);
+	}
+
+	// compresses whole chunk rows on the compression threads and stores the finished chunks with
+	// H5Dwrite_chunk; rowStart and rowCount must satisfy isChunkRowAligned()
+	void writeChunkRowsDirect(OmxIndex rowStart, OmxIndex rowCount, const void *buffer, uint32_t threadCount) {
+		_cachedRowCount = 0;
+
+		auto chunkRows = _chunkDims[0];
+		auto chunkCols = _chunkDims[1];
+		auto rowEnd = rowStart + rowCount;
+		auto rowSize = _zones * _sizeOfDataType;
+		auto chunkSize = chunkRows * chunkCols * _sizeOfDataType;
+
+		OmxIndex colChunks = (_zones + chunkCols - 1) / chunkCols;
+		OmxIndex chunkCount = ((rowCount + chunkRows - 1) / chunkRows) * colChunks;
+		OmxIndex batchSize = threadCount * CHUNKS_PER_COMPRESSION_THREAD;
+
+		std::vector<std::vector<uint8_t>> encoded(std::min(batchSize, chunkCount));
+
+		for (OmxIndex batchStart = 0; batchStart < chunkCount; batchStart += batchSize) {
+			auto batchCount = std::min(batchSize, chunkCount - batchStart);
+
+			parallelFor(batchCount, threadCount, [&](OmxIndex i) {
+				auto chunk = batchStart + i;
+				auto chunkRowStart = rowStart + (chunk / colChunks) * chunkRows;
+				auto colStart = (chunk % colChunks) * chunkCols;
+				auto colCount = std::min(chunkCols, _zones - colStart);
+
+				// edge chunks are padded out to the full chunk shape
+				std::unique_ptr<uint8_t[]> raw(new uint8_t[chunkSize]());
+				for (OmxIndex r = 0; r < chunkRows && chunkRowStart + r < rowEnd; r++) {
+					std::memcpy(raw.get() + r * chunkCols * _sizeOfDataType,
+						(const uint8_t *)buffer + (chunkRowStart + r - rowStart) * rowSize + colStart * _sizeOfDataType,
+						colCount * _sizeOfDataType);
+				}
+
+				encodeChunk(_filters, raw.get(), chunkSize, &encoded[i]);
+			});
+
+			for (OmxIndex i = 0; i < batchCount; i++) {
+				auto chunk = batchStart + i;
+				hsize_t offset[2] = { rowStart + (chunk / colChunks) * chunkRows, (chunk % colChunks) * chunkCols };
+
+				if (H5Dwrite_chunk(_dataset, H5P_DEFAULT, 0, offset, encoded[i].size(), encoded[i].data()) < 0)
+					throw OmxMatrixException("Unable to write compressed chunk of matrix to storage.");
+			}
+		}
+	}
+
+	// whether other stores the same type in chunks of the same shape through the same filters,
+	// so that identical stored chunks hold identical values
+	bool hasSameChunkStorage(const OmxMatrixImpl& other) const {
+		if (!_isChunked || !other._isChunked || !_filters.isSupported || !other._filters.isSupported)
+			return false;
+
+		if (_zones != other._zones || _dataType != other._dataType
+			|| _chunkDims[0] != other._chunkDims[0] || _chunkDims[1] != other._chunkDims[1])
+			return false;
+
+		if (_filters.compressor != other._filters.compressor || _filters.compressorPosition != other._filters.compressorPosition
+			|| _filters.shuffleSize != other._filters.shuffleSize || _filters.shufflePosition != other._filters.shufflePosition)
+			return false;
+
+		H5TypeScoped type(H5Dget_type(_dataset));
+		H5TypeScoped otherType(H5Dget_type(other._dataset));
+		return type >= 0 && otherType >= 0 && H5Tequal(type, otherType) > 0;
+	}
+
+	// compares the stored chunks of a chunk row without decoding them; requires hasSameChunkStorage()
+	bool isChunkRowStorageEqual(OmxMatrixImpl& other, OmxIndex chunkRow) {
+		flushPendingRows();
+		other.flushPendingRows();
+
+		std::vector<uint8_t> chunk, otherChunk;
+		uint32_t filterMask, otherFilterMask;
+
+		for (OmxIndex col = 0; col < _zones; col += _chunkDims[1]) {
+			readStoredChunk(_dataset, chunkRow * _chunkDims[0], col, &chunk, &filterMask);
+			readStoredChunk(other._dataset, chunkRow * _chunkDims[0], col, &otherChunk, &otherFilterMask);
+
+			if (filterMask != otherFilterMask || chunk != otherChunk)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool useDirectChunkReads(uint32_t threadCount) const {
+		return threadCount > 1 && _isChunked && _filters.isCompressed() && canCodeChunksDirectly(_filters);
+	}
+
+	// fetches the raw chunks of the chunk rows covering [rowStart, rowStart + rowCount) with H5Dread_chunk
+	// and inflates them on the decompression threads, outside of HDF5
+	void readChunkRowsDirect(OmxIndex rowStart, OmxIndex rowCount, void *buffer, uint32_t threadCount) {
+		auto chunkRows = _chunkDims[0];
+		auto chunkCols = _chunkDims[1];
+		auto rowEnd = rowStart + rowCount;
+		auto rowSize = _zones * _sizeOfDataType;
+		auto chunkSize = chunkRows * chunkCols * _sizeOfDataType;
+
+		OmxIndex firstStrip = rowStart / chunkRows;
+		OmxIndex colChunks = (_zones + chunkCols - 1) / chunkCols;
+		OmxIndex chunkCount = ((rowEnd + chunkRows - 1) / chunkRows - firstStrip) * colChunks;
+		OmxIndex batchSize = threadCount * CHUNKS_PER_COMPRESSION_THREAD;
+
+		std::vector<std::vector<uint8_t>> encoded(std::min(batchSize, chunkCount));
+		std::vector<uint32_t> filterMasks(encoded.size());
+
+		for (OmxIndex batchStart = 0; batchStart < chunkCount; batchStart += batchSize) {
+			auto batchCount = std::min(batchSize, chunkCount - batchStart);
+
+			for (OmxIndex i = 0; i < batchCount; i++) {
+				auto chunk = batchStart + i;
+				readStoredChunk(_dataset, (firstStrip + chunk / colChunks) * chunkRows, (chunk % colChunks) * chunkCols, &encoded[i], &filterMasks[i]);
+			}
+
+			parallelFor(batchCount, threadCount, [&](OmxIndex i) {
+				auto chunk = batchStart + i;
+				auto chunkRowStart = (firstStrip + chunk / colChunks) * chunkRows;
+				auto colStart = (chunk % colChunks) * chunkCols;
+				auto colCount = std::min(chunkCols, _zones - colStart);
+
+				std::unique_ptr<uint8_t[]> raw(new uint8_t[chunkSize]);
+
+				// unallocated chunks hold the default fill value
+				if (encoded[i].empty())
+					std::memset(raw.get(), 0, chunkSize);
+				else
+					decodeChunk(_filters, filterMasks[i], encoded[i].data(), encoded[i].size(), raw.get(), chunkSize);
+
+				for (OmxIndex r = 0; r < chunkRows; r++) {
+					auto row = chunkRowStart + r;
+					if (row < rowStart || row >= rowEnd)
+						continue;
+
+					std::memcpy((uint8_t *)buffer + (row - rowStart) * rowSize + colStart * _sizeOfDataType,
+						raw.get() + r * chunkCols * _sizeOfDataType,
+						colCount * _sizeOfDataType);
+				}
+			});
+		}
+	}
+
+	// serves rows from a window of decoded chunk rows large enough to keep every decompression thread busy
+	void readRowDirect(OmxIndex row, void *rowBuffer) {
+		auto rowSize = _zones * _sizeOfDataType;
+
+		if (_cachedRowCount == 0 || row < _cachedRowStart || row >= _cachedRowStart + _cachedRowCount) {
+			auto windowRows = getRowWindow(_decompressionThreads);
+
+			if (!_cachedRows || _cachedRowCapacity < windowRows) {
+				_cachedRows.reset(new uint8_t[windowRows * rowSize]);
+				_cachedRowCapacity = windowRows;
+			}
+
+			_cachedRowCount = 0;
+			_cachedRowStart = (row / windowRows) * windowRows;
+
+			auto rowCount = std::min(windowRows, _zones - _cachedRowStart);
+			readChunkRowsDirect(_cachedRowStart, rowCount, _cachedRows.get(), _decompressionThreads);
+			_cachedRowCount = rowCount;
+		}
+
+		std::memcpy(rowBuffer, _cachedRows.get() + (row - _cachedRowStart) * rowSize, rowSize);
+	}
+
+	size_t getDataSizeOfRow() const {
+		return _zones * _sizeOfDataType;
+	}
+
+	void setDecompressionThreads(uint32_t threadCount) {
+		_decompressionThreads = std::max<uint32_t>(threadCount, 1);
+		_cachedRowCount = 0;
+		_cachedRows.reset(nullptr);
+		_cachedRowCapacity = 0;
+	}
+
+	bool hasDecodedRow(OmxIndex row) const {
+		return _cachedRowCount > 0 && row >= _cachedRowStart && row < _cachedRowStart + _cachedRowCount;
+	}
+
+	void copyDecodedRow(OmxIndex row, void *buffer, OmxIndex stride) const {
+		auto rowSize = getDataSizeOfRow();
+		auto source = _cachedRows.get() + (row - _cachedRowStart) * rowSize;
+
+		if (stride == 1) {
+			std::memcpy(buffer, source, rowSize);
+			return;
+		}
+
+		for (OmxIndex col = 0; col < _zones; col++)
+			std::memcpy((uint8_t *)buffer + col * stride * _sizeOfDataType, source + col * _sizeOfDataType, _sizeOfDataType);
+	}
+
+	// Fetches the stored chunks of the chunk row holding row when it has to be decoded, and returns
+	// their number. OmxFile::readRows() fetches for all of its matrices on its thread and then decodes
+	// the chunks of all of them at once with decodeFetchedChunk(), which touches no HDF5.
+	OmxIndex fetchChunkRow(OmxIndex row) {
+		flushPendingRows();
+
+		auto chunkRows = _chunkDims[0];
+		bool canDecode = !_mapping.isMapped() && _isChunked && _filters.isCompressed() && canCodeChunksDirectly(_filters)
+			&& chunkRows * getDataSizeOfRow() <= MAX_ROW_WINDOW_SIZE;
+
+		if (!canDecode || hasDecodedRow(row))
+			return 0;
+
+		if (!_cachedRows || _cachedRowCapacity < chunkRows) {
+			_cachedRows.reset(new uint8_t[chunkRows * getDataSizeOfRow()]);
+			_cachedRowCapacity = chunkRows;
+		}
+
+		_cachedRowCount = 0;
+		_cachedRowStart = (row / chunkRows) * chunkRows;
+
+		OmxIndex colChunks = (_zones + _chunkDims[1] - 1) / _chunkDims[1];
+		_fetchedChunks.resize(colChunks);
+		_fetchedFilterMasks.resize(colChunks);
+
+		for (OmxIndex i = 0; i < colChunks; i++)
+			readStoredChunk(_dataset, _cachedRowStart, i * _chunkDims[1], &_fetchedChunks[i], &_fetchedFilterMasks[i]);
+
+		return colChunks;
+	}
+
+	void decodeFetchedChunk(OmxIndex index) {
+		auto chunkRows = _chunkDims[0];
+		auto chunkCols = _chunkDims[1];
+		auto chunkSize = chunkRows * chunkCols * _sizeOfDataType;
+		auto colStart = index * chunkCols;
+		auto colCount = std::min(chunkCols, _zones - colStart);
+		auto rowCount = std::min(chunkRows, _zones - _cachedRowStart);
+		auto rowSize = getDataSizeOfRow();
+
+		std::unique_ptr<uint8_t[]> raw(new uint8_t[chunkSize]);
+		auto& encoded = _fetchedChunks[index];
+
+		// unallocated chunks hold the default fill value
+		if (encoded.empty())
+			std::memset(raw.get(), 0, chunkSize);
+		else
+			decodeChunk(_filters, _fetchedFilterMasks[index], encoded.data(), encoded.size(), raw.get(), chunkSize);
+
+		for (OmxIndex r = 0; r < rowCount; r++)
+			std::memcpy(_cachedRows.get() + r * rowSize + colStart * _sizeOfDataType, raw.get() + r * chunkCols * _sizeOfDataType, colCount * _sizeOfDataType);
+	}
+
+	void finishChunkRow() {
+		_cachedRowCount = std::min(_chunkDims[0], _zones - _cachedRowStart);
+		_fetchedChunks.clear();
+		_fetchedFilterMasks.clear();
+	}
+
+	// with compression threads several chunk rows are collected so that every thread has chunks to compress
+	OmxIndex getPendingRowCapacity() const {
+		auto capacity = useDirectChunkWrites(_compressionThreads) ? getRowWindow(_compressionThreads) : _chunkDims[0];
+
+		return capacity * _zones * _sizeOfDataType <= MAX_ROW_WINDOW_SIZE ? capacity : 1;
+	}
+
+	// whole chunk rows holding enough chunks to keep every thread busy
+	OmxIndex getRowWindow(uint32_t threadCount) const {
+		OmxIndex chunksPerStrip = (_zones + _chunkDims[1] - 1) / _chunkDims[1];
+		OmxIndex strips = (threadCount * CHUNKS_PER_COMPRESSION_THREAD + chunksPerStrip - 1) / chunksPerStrip;
+
+		return _chunkDims[0] * std::max<OmxIndex>(strips, 1);
+	}
+
+	void setCompressionThreads(uint32_t threadCount) {
+		flushPendingRows();
+
+		_compressionThreads = std::max<uint32_t>(threadCount, 1);
+		_pendingRows.reset(nullptr);
+	}
+
+	void writeRowH5(OmxIndex row, void *rowBuffer) {
+		hsize_t dims[2], start[2];
+
+		_cachedRowCount = 0;
+
+		dims[0] = 1;
+		dims[1] = _zones;
+
+		start[0] = row;
+		start[1] = 0;
+
+		if (_memspace < 0)
+			_memspace = H5Screate_simple(2, dims, NULL);
+
+		if (_dataspace < 0) {
+			_dataspace = H5Dget_space(_dataset);
+		}
+
+		H5Sselect_hyperslab(_dataspace, H5S_SELECT_SET, start, NULL, dims, NULL);
+
+		herr_t status = H5Dwrite(_dataset,
+			getH5DataType(_dataType),
+			_memspace,
+			_dataspace,
+			H5P_DEFAULT,
+			rowBuffer);
+
+		if (status < 0) {
+			throw OmxMatrixException("Unable to write row of matrix to storage.");
+		}
+	}
+
+	// rows are collected until a whole chunk row is available so that each chunk is
+	// written (and compressed) once instead of once per row
+	void writeRow(OmxIndex row, void *rowBuffer) {
+		_writeGeneration++;
+		addRowsToStats(row, 1, rowBuffer);
+
+		auto capacity = getPendingRowCapacity();
+
+		if (capacity <= 1) {
+			writeRowH5(row, rowBuffer);
+			return;
+		}
+
+		if (_pendingRowCount > 0 && row != _pendingRowStart + _pendingRowCount)
+			flushPendingRows();
+
+		auto rowSize = _zones * _sizeOfDataType;
+
+		if (_pendingRowCount == 0) {
+			if (!_pendingRows)
+				_pendingRows.reset(new uint8_t[capacity * rowSize]);
+
+			_pendingRowStart = row;
+		}
+
+		std::memcpy(_pendingRows.get() + _pendingRowCount * rowSize, rowBuffer, rowSize);
+		_pendingRowCount++;
+
+		if ((row + 1) % capacity == 0 || row + 1 == _zones)
+			flushPendingRows();
+	}
+
+	void flushPendingRows() {
+		if (_pendingRowCount == 0)
+			return;
+
+		auto rowCount = _pendingRowCount;
+		_pendingRowCount = 0;
+		_cachedRowCount = 0;
+
+		if (useDirectChunkWrites(_compressionThreads) && isChunkRowAligned(_pendingRowStart, rowCount))
+			writeChunkRowsDirect(_pendingRowStart, rowCount, _pendingRows.get(), _compressionThreads);
+		else
+			transferBlockH5(true, _pendingRowStart, rowCount, 0, _zones, _pendingRows.get());
+	}
+
+	void requireValidBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount) const {
+		if (rowCount == 0 || colCount == 0
+			|| rowStart >= _zones || rowCount > _zones - rowStart
+			|| colStart >= _zones || colCount > _zones - colStart) {
+			throw std::out_of_range("Block at (" + std::to_string(rowStart) + ", " + std::to_string(colStart) + ") of size "
+				+ std::to_string(rowCount) + "x" + std::to_string(colCount) + " was out of the acceptable range.");
+		}
+	}
+
+	// Reads the matrix in strips of whole chunk rows on this thread, decoding with threadCount threads,
+	// and hands each strip to fn. Mapped matrices are handed out straight from the mapping.
+	void forEachStrip(uint32_t threadCount, const std::function<void(OmxIndex, OmxIndex, const uint8_t *)>& fn) {
+		flushPendingRows();
+
+		auto rowSize = getDataSizeOfRow();
+		auto chunkRows = std::max<OmxIndex>(_chunkDims[0], 1);
+		auto stripRows = chunkRows * std::max<OmxIndex>(STREAM_STRIP_SIZE / std::max<size_t>(rowSize * chunkRows, 1), 1);
+		stripRows = std::min(stripRows, _zones);
+
+		if (_mapping.isMapped()) {
+			for (OmxIndex row = 0; row < _zones; row += stripRows)
+				fn(row, std::min(stripRows, _zones - row), _mapping.data() + row * rowSize);
+
+			return;
+		}
+
+		std::unique_ptr<uint8_t[]> strip(new uint8_t[stripRows * rowSize]);
+		for (OmxIndex row = 0; row < _zones; row += stripRows) {
+			auto rowCount = std::min(stripRows, _zones - row);
+
+			if (useDirectChunkReads(threadCount))
+				readChunkRowsDirect(row, rowCount, strip.get(), threadCount);
+			else
+				transferBlockH5(false, row, rowCount, 0, _zones, strip.get());
+
+			fn(row, rowCount, strip.get());
+		}
+	}
+
+	OmxMatrixSummary summarize(uint32_t threadCount) {
+		OmxMatrixSummary summary{ std::vector<double>(_zones, 0.0), std::vector<double>(_zones, 0.0), 0.0,
+			std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity() };
+
+		threadCount = std::max<uint32_t>(threadCount, 1);
+
+		withValueType(_dataType, [&](auto type) {
+			typedef std::remove_pointer_t<decltype(type)> T;
+
+			forEachStrip(threadCount, [&](OmxIndex rowStart, OmxIndex rowCount, const uint8_t *strip) {
+				// every task sums its own rows and keeps its own column sums and extremes
+				OmxIndex taskCount = std::min<OmxIndex>(rowCount, threadCount);
+				std::vector<std::vector<double>> columnSums(taskCount);
+				std::vector<double> minValues(taskCount), maxValues(taskCount);
+
+				parallelFor(taskCount, threadCount, [&](OmxIndex task) {
+					columnSums[task].assign(_zones, 0.0);
+					double *columns = columnSums[task].data();
+					double minValue = std::numeric_limits<double>::infinity();
+					double maxValue = -std::numeric_limits<double>::infinity();
+
+					for (OmxIndex r = task * rowCount / taskCount; r < (task + 1) * rowCount / taskCount; r++) {
+						const T *values = (const T *)strip + r * _zones;
+						summary.rowSums[rowStart + r] = summarizeRow(values, _zones, columns, &minValue, &maxValue);
+					}
+
+					minValues[task] = minValue;
+					maxValues[task] = maxValue;
+				});
+
+				for (OmxIndex task = 0; task < taskCount; task++) {
+					for (OmxIndex c = 0; c < _zones; c++)
+						summary.columnSums[c] += columnSums[task][c];
+
+					summary.min = std::min(summary.min, minValues[task]);
+					summary.max = std::max(summary.max, maxValues[task]);
+				}
+			});
+		});
+
+		for (auto sum : summary.rowSums)
+			summary.total += sum;
+
+		return summary;
+	}
+
+	// Statistics cover the values written since the matrix was added or opened. They stay valid
+	// while every row is written whole and at most once, which is what most writers do.
+	void addRowsToStats(OmxIndex rowStart, OmxIndex rowCount, const void *buffer) {
+		_isStatsDirty = true;
+
+		if (!_isStatsValid)
+			return;
+
+		if (_statsRows.empty())
+			_statsRows.assign(_zones, false);
+
+		for (OmxIndex row = rowStart; row < rowStart + rowCount; row++) {
+			if (_statsRows[row]) {
+				invalidateStats();
+				return;
+			}
+		}
+
+		std::fill(_statsRows.begin() + rowStart, _statsRows.begin() + rowStart + rowCount, true);
+		_statsRowCount += rowCount;
+
+		withValueType(_dataType, [&](auto type) {
+			accumulateStats((const std::remove_pointer_t<decltype(type)> *)buffer, rowCount * _zones, _stats);
+		});
+	}
+
+	void invalidateStats() {
+		_isStatsDirty = true;
+		_isStatsValid = false;
+		_statsRows.clear();
+		_statsRows.shrink_to_fit();
+	}
+
+	bool hasCompleteStats() const {
+		return _isStatsValid && _statsRowCount == _zones;
+	}
+
+	// stores complete statistics as attributes, or removes stored ones the writes have made stale
+	void persistStats() {
+		if (!_isStatsDirty || !_attributes)
+			return;
+
+		_isStatsDirty = false;
+
+		if (hasCompleteStats()) {
+			_attributes->setAttributeDouble(HDF5_ATTR_OMX_STATS_SUM, _stats.sum);
+			_attributes->setAttributeDouble(HDF5_ATTR_OMX_STATS_MIN, _stats.min);
+			_attributes->setAttributeDouble(HDF5_ATTR_OMX_STATS_MAX, _stats.max);
+			_attributes->setAttributeUInt64(HDF5_ATTR_OMX_STATS_NONZERO, _stats.nonZeroCount);
+			_attributes->setAttributeUInt64(HDF5_ATTR_OMX_STATS_NAN, _stats.nanCount);
+			return;
+		}
+
+		for (auto name : STATS_ATTRIBUTE_NAMES) {
+			if (_attributes->hasAttribute(name))
+				_attributes->removeAttribute(name);
+		}
+	}
+
+	bool hasStoredStats() const {
+		if (hasCompleteStats())
+			return true;
+
+		if (_isStatsDirty || !_attributes)
+			return false;
+
+		for (auto name : STATS_ATTRIBUTE_NAMES) {
+			if (!_attributes->hasAttribute(name))
+				return false;
+		}
+
+		return true;
+	}
+
+	OmxMatrixStats getStoredStats() const {
+		if (!hasStoredStats())
+			throw OmxMatrixException("Matrix '" + _name + "' has no stored statistics.");
+
+		if (hasCompleteStats())
+			return _stats;
+
+		return OmxMatrixStats{
+			_attributes->getAttributeDouble(HDF5_ATTR_OMX_STATS_SUM),
+			_attributes->getAttributeDouble(HDF5_ATTR_OMX_STATS_MIN),
+			_attributes->getAttributeDouble(HDF5_ATTR_OMX_STATS_MAX),
+			_attributes->getAttributeUInt64(HDF5_ATTR_OMX_STATS_NONZERO),
+			_attributes->getAttributeUInt64(HDF5_ATTR_OMX_STATS_NAN) };
+	}
+
+	// reads row with its values stride elements apart in buffer; it only uses HDF5 and local
+	// dataspaces, so it can run on another thread when HDF5 is thread-safe
+	void readRowH5(OmxIndex row, void *buffer, OmxIndex stride) const {
+		hsize_t start[2] = { row, 0 };
+		hsize_t count[2] = { 1, _zones };
+		hsize_t memDims[1] = { (_zones - 1) * stride + 1 };
+		hsize_t memStart[1] = { 0 };
+		hsize_t memStride[1] = { stride };
+		hsize_t memCount[1] = { _zones };
+
+		H5DataspaceScoped memspace(H5Screate_simple(1, memDims, NULL));
+		H5DataspaceScoped dataspace(H5Dget_space(_dataset));
+
+		if (memspace < 0 || dataspace < 0
+			|| H5Sselect_hyperslab(memspace, H5S_SELECT_SET, memStart, memStride, memCount, NULL) < 0
+			|| H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, NULL, count, NULL) < 0) {
+			throw OmxMatrixException("Unable to prepare for reading the matrix.");
+		}
+
+		if (H5Dread(_dataset, getH5DataType(_dataType), memspace, dataspace, H5P_DEFAULT, buffer) < 0)
+			throw OmxMatrixException("Unable to read matrix.");
+	}
+
+	// blocks use their own dataspaces so they don't disturb the cached row selection; writers drop
+	// the decoded rows of readRow() themselves, this also runs on transferMatrix() threads
+	void transferBlockH5(bool isWrite, OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+		hsize_t dims[2], start[2];
+
+		dims[0] = rowCount;
+		dims[1] = colCount;
+
+		start[0] = rowStart;
+		start[1] = colStart;
+
+		H5DataspaceScoped memspace(H5Screate_simple(2, dims, NULL));
+		H5DataspaceScoped dataspace(H5Dget_space(_dataset));
+
+		if (memspace < 0 || dataspace < 0 || H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, NULL, dims, NULL) < 0) {
+			throw OmxMatrixException("Unable to prepare for " + std::string(isWrite ? "writing" : "reading") + " the matrix block.");
+		}
+
+		if (isWrite) {
+			if (H5Dwrite(_dataset, getH5DataType(_dataType), memspace, dataspace, H5P_DEFAULT, buffer) < 0)
+				throw OmxMatrixException("Unable to write block of matrix to storage.");
+		}
+		else {
+			if (H5Dread(_dataset, getH5DataType(_dataType), memspace, dataspace, H5P_DEFAULT, buffer) < 0)
+				throw OmxMatrixException("Unable to read matrix block.");
+		}
+	}
+
+	void readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+		requireValidBlock(rowStart, rowCount, colStart, colCount);
+		flushPendingRows();
+
+		if (colStart == 0 && colCount == _zones && useDirectChunkReads(_decompressionThreads))
+			readChunkRowsDirect(rowStart, rowCount, buffer, _decompressionThreads);
+		else
+			transferBlockH5(false, rowStart, rowCount, colStart, colCount, buffer);
+	}
+
+	void writeBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer) {
+		requireValidBlock(rowStart, rowCount, colStart, colCount);
+		flushPendingRows();
+
+		if (colStart == 0 && colCount == _zones)
+			addRowsToStats(rowStart, rowCount, buffer);
+		else
+			invalidateStats();
+
+		_cachedRowCount = 0;
+
+		if (colStart == 0 && colCount == _zones && useDirectChunkWrites(_compressionThreads) && isChunkRowAligned(rowStart, rowCount))
+			writeChunkRowsDirect(rowStart, rowCount, buffer, _compressionThreads);
+		else
+			transferBlockH5(true, rowStart, rowCount, colStart, colCount, const_cast<void *>(buffer));
+	}
+
+	// splits the matrix into runs of whole chunk rows so that no chunk is shared between threads
+	void transferMatrix(bool isWrite, void *buffer, uint32_t threadCount) {
+		if (isWrite) {
+			_writeGeneration++;
+			_cachedRowCount = 0;
+			addRowsToStats(0, _zones, buffer);
+		}
+
+		flushPendingRows();
+
+		if (!isWrite && _mapping.isMapped()) {
+			std::memcpy(buffer, _mapping.data(), _mapping.size());
+			return;
+		}
+
+		auto compressionThreads = std::max(threadCount, _compressionThreads);
+		if (isWrite && useDirectChunkWrites(compressionThreads)) {
+			writeChunkRowsDirect(0, _zones, buffer, compressionThreads);
+			return;
+		}
+
+		auto decompressionThreads = std::max(threadCount, _decompressionThreads);
+		if (!isWrite && useDirectChunkReads(decompressionThreads)) {
+			readChunkRowsDirect(0, _zones, buffer, decompressionThreads);
+			return;
+		}
+
+		if (threadCount > 1 && !isH5ThreadSafe())
+			threadCount = 1;
+
+		if (threadCount <= 1) {
+			transferBlockH5(isWrite, 0, _zones, 0, _zones, buffer);
+			return;
+		}
+
+		auto stripSize = std::max<size_t>(_chunkDims[0] * _zones * _sizeOfDataType, 1);
+		auto stripsPerTask = std::max<size_t>(MIN_PARALLEL_TRANSFER_SIZE / stripSize, 1);
+		OmxIndex rowsPerTask = _chunkDims[0] * stripsPerTask;
+		OmxIndex taskCount = (_zones + rowsPerTask - 1) / rowsPerTask;
+		auto rowSize = _zones * _sizeOfDataType;
+
+		parallelFor(taskCount, threadCount, [&](OmxIndex task) {
+			auto rowStart = task * rowsPerTask;
+			auto rowCount = std::min(rowsPerTask, _zones - rowStart);
+
+			transferBlockH5(isWrite, rowStart, rowCount, 0, _zones, (uint8_t *)buffer + rowStart * rowSize);
+		});
+	}
+
+	// reads each chunk that holds a requested column once and scatters every requested column out of it
+	void readColumns(const std::vector<OmxIndex>& columns, void *buffer) {
+		for (auto col : columns) {
+			if (col >= _zones)
+				throw std::out_of_range("Column index " + std::to_string(col) + " was out of the acceptable range.");
+		}
+
+		// mapped values and chunks decoded outside of HDF5 come in strips of whole rows
+		if (_mapping.isMapped() || useDirectChunkReads(_decompressionThreads)) {
+			std::vector<std::pair<OmxIndex, OmxIndex>> stripColumns;
+			for (OmxIndex k = 0; k < columns.size(); k++)
+				stripColumns.emplace_back(k, columns[k]);
+
+			forEachStrip(_decompressionThreads, [&](OmxIndex rowStart, OmxIndex rowCount, const uint8_t *strip) {
+				scatterBlockColumns(strip, rowCount, _zones, stripColumns, buffer, rowStart);
+			});
+
+			return;
+		}
+
+		flushPendingRows();
+
+		// (output position, column within chunk) grouped by chunk column
+		std::map<OmxIndex, std::vector<std::pair<OmxIndex, OmxIndex>>> chunkColumns;
+		for (OmxIndex k = 0; k < columns.size(); k++) {
+			chunkColumns[columns[k] / _chunkDims[1]].emplace_back(k, columns[k] % _chunkDims[1]);
+		}
+
+		auto chunkRows = _chunkDims[0];
+		std::unique_ptr<uint8_t[]> block(new uint8_t[chunkRows * _chunkDims[1] * _sizeOfDataType]);
+
+		for (OmxIndex rowStart = 0; rowStart < _zones; rowStart += chunkRows) {
+			auto rowCount = std::min(chunkRows, _zones - rowStart);
+
+			for (const auto& chunk : chunkColumns) {
+				auto colStart = chunk.first * _chunkDims[1];
+				auto colCount = std::min(_chunkDims[1], _zones - colStart);
+
+				transferBlockH5(false, rowStart, rowCount, colStart, colCount, block.get());
+				scatterBlockColumns(block.get(), rowCount, colCount, chunk.second, buffer, rowStart);
+			}
+		}
+	}
+
+	void scatterBlockColumns(const uint8_t *block, OmxIndex rowCount, OmxIndex blockCols,
+		const std::vector<std::pair<OmxIndex, OmxIndex>>& columns, void *buffer, OmxIndex rowStart) const {
+		switch (_sizeOfDataType) {
+		case 1: scatterColumns((const uint8_t *)block, rowCount, blockCols, columns, (uint8_t *)buffer, rowStart, _zones); break;
+		case 2: scatterColumns((const uint16_t *)block, rowCount, blockCols, columns, (uint16_t *)buffer, rowStart, _zones); break;
+		case 4: scatterColumns((const uint32_t *)block, rowCount, blockCols, columns, (uint32_t *)buffer, rowStart, _zones); break;
+		case 8: scatterColumns((const uint64_t *)block, rowCount, blockCols, columns, (uint64_t *)buffer, rowStart, _zones); break;
+		default: throw OmxMatrixException("Unsupported data type size for column reads.");
+		}
+	}
+
+	// the background reads of the file are waited for, the cursors of the user can't be
+	void setChunkCacheSettings(OmxAccessPattern accessHint, size_t requestedCacheSize) {
+		if (_waitForBackgroundReads)
+			_waitForBackgroundReads();
+
+		if (*_readerCount > 0)
+			throw OmxMatrixException("The chunk cache of matrix '" + _name + "' can't be changed while cursors are open.");
+
+		_accessHint = accessHint;
+		_requestedCacheSize = requestedCacheSize;
+		configureChunkCache();
+	}
+
+	// sizes the chunk cache for the access hint; the cache is fixed when a dataset is opened,
+	// so the dataset is reopened with the new settings
+	void configureChunkCache() {
+		if (!_isChunked)
+			return;
 
-		OmxAttributeOwnerData attributeOwnerData{ _dataset, "." };
-		_attributes.reset(new OmxAttributeCollection(&attributeOwnerData));
+		flushPendingRows();
 
-		_isClosed = false;
+		size_t chunkSize = _chunkDims[0] * _chunkDims[1] * _sizeOfDataType;
+		size_t chunksPerStrip = (_zones + _chunkDims[1] - 1) / _chunkDims[1];
+		size_t strips = (_zones + _chunkDims[0] - 1) / _chunkDims[0];
+		size_t requested;
+		double preemption;
+
+		switch (_accessHint) {
+		case OmxAccessPattern::Sequential:
+			// one chunk row, fully read chunks are evicted first
+			requested = chunksPerStrip * chunkSize;
+			preemption = 1.0;
+			break;
+		case OmxAccessPattern::Column:
+			// one chunk column, which is revisited by every column within it
+			requested = strips * chunkSize;
+			preemption = 0.0;
+			break;
+		case OmxAccessPattern::Block:
+			requested = 2 * chunksPerStrip * chunkSize;
+			preemption = 0.5;
+			break;
+		default:
+			requested = DEFAULT_CHUNK_CACHE_SIZE;
+			preemption = 0.75;
+			break;
+		}
+
+		// hinted sizes beyond the cap hold as many whole chunks as fit, e.g. part of a column of row
+		// strip chunks; only a cap below a single chunk leaves the default
+		size_t maxHinted = MAX_HINTED_CHUNK_CACHE_SIZE;
+		if (_cacheBudget && _cacheBudget->getLimit() > 0)
+			maxHinted = std::min(maxHinted, _cacheBudget->getLimit());
+
+		if (requested > maxHinted) {
+			if (chunkSize <= maxHinted) {
+				requested = maxHinted / chunkSize * chunkSize;
+			}
+			else {
+				requested = std::min(DEFAULT_CHUNK_CACHE_SIZE, maxHinted);
+				preemption = 0.75;
+			}
+		}
+
+		if (_requestedCacheSize > 0)
+			requested = _requestedCacheSize;
+
+		if (_cacheBudget) {
+			_cacheBudget->release(_grantedCacheSize);
+			_grantedCacheSize = _cacheBudget->reserve(requested);
+		}
+		else {
+			_grantedCacheSize = requested;
+		}
+
+		H5PlistScoped dapl(H5Pcreate(H5P_DATASET_ACCESS));
+		if (dapl < 0 || H5Pset_chunk_cache(dapl, getChunkCacheSlots(_grantedCacheSize, chunkSize), _grantedCacheSize, preemption) < 0)
+			throw OmxMatrixException("Unable to configure the chunk cache of matrix '" + _name + "'.");
+
+		H5Dclose(_dataset);
+		_dataset = H5Dopen(_fileHandle, _path.c_str(), dapl);
+
+		if (_dataset < 0)
+			throw OmxMatrixException("Unable to reopen matrix '" + _name + "'.");
 	}
 
-	~OmxMatrixImpl() {
-		close();
+	size_t getChunkCacheSize() const {
+		size_t slots = 0, size = 0;
+		double preemption = 0;
+
+		H5PlistScoped dapl(H5Dget_access_plist(_dataset));
+		if (dapl < 0 || H5Pget_chunk_cache(dapl, &slots, &size, &preemption) < 0)
+			throw OmxMatrixException("Unable to determine the chunk cache size of matrix '" + _name + "'.");
+
+		return size;
 	}
 
-	void writeRowH5(OmxIndex row, void *rowBuffer) {
-		hsize_t dims[2], start[2];
+	// maps the stored values of a contiguous matrix straight from the file; the file data has to be
+	// in the native byte order and the file opened with the default (sec2) driver
+	const void *mapReadOnly() {
+		if (_mapping.isMapped())
+			return _mapping.data();
 
-		dims[0] = 1;
-		dims[1] = _zones;
+		flushPendingRows();
 
-		start[0] = row;
-		start[1] = 0;
+		H5PlistScoped createPlist(H5Dget_create_plist(_dataset));
+		if (createPlist < 0 || H5Pget_layout(createPlist) != H5D_CONTIGUOUS)
+			throw OmxMatrixException("Only matrices with a contiguous layout can be mapped.");
 
-		if (_memspace < 0)
-			_memspace = H5Screate_simple(2, dims, NULL);
+		H5TypeScoped fileType(H5Dget_type(_dataset));
+		H5TypeScoped nativeType(H5Tget_native_type(fileType, H5T_DIR_DEFAULT));
+		if (fileType < 0 || nativeType < 0 || H5Tequal(fileType, nativeType) <= 0)
+			throw OmxMatrixException("Only matrices stored in the native byte order can be mapped.");
 
-		if (_dataspace < 0) {
-			_dataspace = H5Dget_space(_dataset);
-		}
+		H5PlistScoped accessPlist(H5Fget_access_plist(_fileHandle));
+		if (accessPlist < 0 || H5Pget_driver(accessPlist) != H5FD_SEC2)
+			throw OmxMatrixException("Only matrices of files opened from disk can be mapped.");
 
-		H5Sselect_hyperslab(_dataspace, H5S_SELECT_SET, start, NULL, dims, NULL);
+		// values written through HDF5 may still be held in its buffers
+		if (H5Fflush(_dataset, H5F_SCOPE_LOCAL) < 0)
+			throw OmxMatrixException("Unable to flush matrix before mapping.");
 
-		herr_t status = H5Dwrite(_dataset,
-			getH5DataType(_dataType),
-			_memspace,
-			_dataspace,
-			H5P_DEFAULT,
-			rowBuffer);
+		haddr_t offset = H5Dget_offset(_dataset);
+		if (offset == HADDR_UNDEF)
+			throw OmxMatrixException("Matrix has no storage to map.");
 
-		if (status < 0) {
-			throw OmxMatrixException("Unable to write row of matrix to storage.");
-		}
+		ssize_t nameSize = H5Fget_name(_dataset, NULL, 0);
+		if (nameSize <= 0)
+			throw OmxMatrixException("Unable to locate file of matrix.");
+
+		std::string filename(nameSize, '\0');
+		H5Fget_name(_dataset, &filename[0], nameSize + 1);
+
+		_mapping.map(filename, offset, _zones * _zones * _sizeOfDataType);
+		return _mapping.data();
 	}
 
-	void writeRow(OmxIndex row, void *rowBuffer) {
-		writeRowH5(row, rowBuffer);
+	// reads are served from the mapping, which writes through HDF5 would leave stale
+	void requireUnmapped() const {
+		if (_mapping.isMapped())
+			throw OmxMatrixException("Matrix '" + _name + "' is mapped read only; unmap it before writing.");
+	}
+
+	void discard() {
+		_pendingRowCount = 0;
+		_isStatsDirty = false;
+		close();
 	}
 
 	void close() {
+		_mapping.unmap();
+
 		if (_dataspace >= 0)
 			H5Sclose(_dataspace);
 
@@ -80,19 +1125,73 @@ public:
 
 		_attributes.reset(nullptr);
 
+		if (_dataset >= 0)
+			H5Dclose(_dataset);
+
+		if (_cacheBudget)
+			_cacheBudget->release(_grantedCacheSize);
+
+		_dataspace = -1;
+		_memspace = -1;
+		_dataset = -1;
+		_grantedCacheSize = 0;
+
 		_isClosed = true;
 	}
 
 	OmxIndex _zones;
+	OmxIndex _chunkDims[2];
+	bool _isChunked;
+
+	OmxFileMapping _mapping;
+	OmxChunkFilters _filters;
+	uint32_t _compressionThreads;
+	uint32_t _decompressionThreads;
+
+	// decoded chunk rows kept by readRow() when decompressing on threads and by OmxFile::readRows()
+	std::unique_ptr<uint8_t[]> _cachedRows;
+	OmxIndex _cachedRowCapacity;
+	OmxIndex _cachedRowStart;
+	OmxIndex _cachedRowCount;
+
+	// stored chunks of one chunk row fetched for OmxFile::readRows(), decoded into _cachedRows
+	std::vector<std::vector<uint8_t>> _fetchedChunks;
+	std::vector<uint32_t> _fetchedFilterMasks;
 
 	hid_t _memspace;
 	hid_t _dataspace;
+	hid_t _fileHandle;
 	hid_t _dataset;
+	std::string _path;
+
+	OmxChunkCacheBudget *_cacheBudget;
+	std::function<void()> _waitForBackgroundReads;
+
+	// open cursors, which hold the dataset handle that configureChunkCache() would replace
+	std::shared_ptr<std::atomic<uint32_t>> _readerCount;
+
+	OmxAccessPattern _accessHint;
+	size_t _requestedCacheSize;
+	size_t _grantedCacheSize;
+
+	std::unique_ptr<uint8_t[]> _pendingRows;
+	OmxIndex _pendingRowStart;
+	OmxIndex _pendingRowCount;
 
 	bool _isClosed;
 
+	// counts the writes, so that rows read ahead can be recognised as outdated
+	uint64_t _writeGeneration;
+
+	OmxMatrixStats _stats;
+	std::vector<bool> _statsRows;
+	OmxIndex _statsRowCount;
+	bool _isStatsValid;
+	bool _isStatsDirty;
+
 	OmxDataType _dataType;
 	OmxCompressionLevel _compressionLevel;
+	OmxCompressionCodec _compressionCodec;
 
 	// cache the dataType size
 	size_t _sizeOfDataType;
@@ -101,8 +1200,209 @@ public:
 	std::string _name;
 };
 
+// What a cursor reads with, taken from the matrix when the cursor is opened. Selections and the decoded
+// chunk row belong to the cursor, the dataset handle is shared with the matrix.
+class OmxMatrixCursor::OmxMatrixCursorImpl {
+public:
+	OmxMatrixCursorImpl(hid_t dataset, OmxIndex zones, OmxDataType dataType, const OmxIndex *chunkDims,
+						const OmxChunkFilters& filters, bool isDirect, const uint8_t *mappedData,
+						const std::shared_ptr<std::atomic<uint32_t>>& readerCount) :
+								_readerCount( readerCount ),
+								_dataset( dataset ),
+								_zones( zones ),
+								_dataType( dataType ),
+								_sizeOfDataType( getDataTypeSize(dataType) ),
+								_filters( filters ),
+								_isDirect( isDirect ),
+								_mappedData( mappedData ) {
+		_chunkDims[0] = chunkDims[0];
+		_chunkDims[1] = chunkDims[1];
+		_chunkRow = 0;
+		_hasChunkRow = false;
+		_dataspace = -1;
+		_memspace = -1;
+		(*_readerCount)++;
+	}
+
+	~OmxMatrixCursorImpl() {
+		(*_readerCount)--;
+
+		OmxH5CallLock lock;
+
+		if (_dataspace >= 0)
+			H5Sclose(_dataspace);
+
+		if (_memspace >= 0)
+			H5Sclose(_memspace);
+	}
+
+	void readRow(OmxIndex row, void *rowBuffer) {
+		if (row >= _zones)
+			throw std::out_of_range("Row index " + std::to_string(row) + " was out of the acceptable range.");
+
+		auto rowSize = _zones * _sizeOfDataType;
+
+		if (_mappedData) {
+			std::memcpy(rowBuffer, _mappedData + row * rowSize, rowSize);
+			return;
+		}
+
+		if (_isDirect) {
+			auto chunkRow = row / _chunkDims[0];
+			if (!_hasChunkRow || chunkRow != _chunkRow)
+				readChunkRow(chunkRow);
+
+			std::memcpy(rowBuffer, _chunkRowData.get() + (row - chunkRow * _chunkDims[0]) * rowSize, rowSize);
+			return;
+		}
+
+		hsize_t start[2] = { row, 0 };
+		hsize_t count[2] = { 1, _zones };
+
+		OmxH5CallLock lock;
+
+		if (_dataspace < 0)
+			_dataspace = H5Dget_space(_dataset);
+
+		if (_memspace < 0)
+			_memspace = H5Screate_simple(2, count, NULL);
+
+		if (_dataspace < 0 || _memspace < 0 || H5Sselect_hyperslab(_dataspace, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+			throw OmxMatrixException("Unable to prepare for reading the matrix.");
+
+		if (H5Dread(_dataset, getH5DataType(_dataType), _memspace, _dataspace, H5P_DEFAULT, rowBuffer) < 0)
+			throw OmxMatrixException("Unable to read matrix.");
+	}
+
+	// fetches the stored chunks of a chunk row under the HDF5 lock and decodes them on this thread
+	void readChunkRow(OmxIndex chunkRow) {
+		auto chunkRows = _chunkDims[0];
+		auto chunkCols = _chunkDims[1];
+		auto rowSize = _zones * _sizeOfDataType;
+		auto chunkSize = chunkRows * chunkCols * _sizeOfDataType;
+		auto rowStart = chunkRow * chunkRows;
+
+		if (!_chunkRowData) {
+			_chunkRowData.reset(new uint8_t[chunkRows * rowSize]);
+			_chunk.reset(new uint8_t[chunkSize]);
+		}
+
+		_hasChunkRow = false;
+
+		for (OmxIndex col = 0; col < _zones; col += chunkCols) {
+			uint32_t filterMask = 0;
+			{
+				OmxH5CallLock lock;
+				readStoredChunk(_dataset, rowStart, col, &_encoded, &filterMask);
+			}
+
+			// unallocated chunks hold the default fill value
+			if (_encoded.empty())
+				std::memset(_chunk.get(), 0, chunkSize);
+			else
+				decodeChunk(_filters, filterMask, _encoded.data(), _encoded.size(), _chunk.get(), chunkSize);
+
+			auto colCount = std::min(chunkCols, _zones - col);
+			for (OmxIndex r = 0; r < chunkRows && rowStart + r < _zones; r++) {
+				std::memcpy(_chunkRowData.get() + r * rowSize + col * _sizeOfDataType,
+					_chunk.get() + r * chunkCols * _sizeOfDataType,
+					colCount * _sizeOfDataType);
+			}
+		}
+
+		_chunkRow = chunkRow;
+		_hasChunkRow = true;
+	}
+
+	void readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+		if (rowCount == 0 || colCount == 0
+			|| rowStart >= _zones || rowCount > _zones - rowStart
+			|| colStart >= _zones || colCount > _zones - colStart) {
+			throw std::out_of_range("Block at (" + std::to_string(rowStart) + ", " + std::to_string(colStart) + ") of size "
+				+ std::to_string(rowCount) + "x" + std::to_string(colCount) + " was out of the acceptable range.");
+		}
+
+		if (_mappedData) {
+			for (OmxIndex r = 0; r < rowCount; r++) {
+				std::memcpy((uint8_t *)buffer + r * colCount * _sizeOfDataType,
+					_mappedData + ((rowStart + r) * _zones + colStart) * _sizeOfDataType,
+					colCount * _sizeOfDataType);
+			}
+
+			return;
+		}
+
+		hsize_t start[2] = { rowStart, colStart };
+		hsize_t count[2] = { rowCount, colCount };
+
+		OmxH5CallLock lock;
+
+		H5DataspaceScoped memspace(H5Screate_simple(2, count, NULL));
+		H5DataspaceScoped dataspace(H5Dget_space(_dataset));
+
+		if (memspace < 0 || dataspace < 0 || H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+			throw OmxMatrixException("Unable to prepare for reading the matrix block.");
+
+		if (H5Dread(_dataset, getH5DataType(_dataType), memspace, dataspace, H5P_DEFAULT, buffer) < 0)
+			throw OmxMatrixException("Unable to read matrix block.");
+	}
+
+	std::shared_ptr<std::atomic<uint32_t>> _readerCount;
+	hid_t _dataset;
+	OmxIndex _zones;
+	OmxDataType _dataType;
+	size_t _sizeOfDataType;
+	OmxIndex _chunkDims[2];
+	OmxChunkFilters _filters;
+
+	// chunks are decoded by the cursor, otherwise rows are read through HDF5
+	bool _isDirect;
+	const uint8_t *_mappedData;
+
+	std::unique_ptr<uint8_t[]> _chunkRowData;
+	std::unique_ptr<uint8_t[]> _chunk;
+	std::vector<uint8_t> _encoded;
+	OmxIndex _chunkRow;
+	bool _hasChunkRow;
+
+	hid_t _dataspace;
+	hid_t _memspace;
+};
+
+OmxMatrixCursor::OmxMatrixCursor(OmxMatrixCursorImpl *impl) : _impl{ impl } {
+}
+
+OmxMatrixCursor::OmxMatrixCursor(OmxMatrixCursor&& other) = default;
+
+OmxMatrixCursor & OmxMatrixCursor::operator=(OmxMatrixCursor&& other) = default;
+
+OmxMatrixCursor::~OmxMatrixCursor() = default;
+
+void OmxMatrixCursor::readRow(OmxIndex row, void *rowBuffer) {
+	_impl->readRow(row, rowBuffer);
+}
+
+void OmxMatrixCursor::readRow(OmxIndex row, void *rowBuffer, OmxDataType dataType) {
+	if (dataType != _impl->_dataType)
+		throw std::invalid_argument("Data type mismatch.");
+
+	_impl->readRow(row, rowBuffer);
+}
+
+void OmxMatrixCursor::readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+	_impl->readBlock(rowStart, rowCount, colStart, colCount, buffer);
+}
+
+OmxIndex OmxMatrixCursor::getZones() const {
+	return _impl->_zones;
+}
+
+OmxDataType OmxMatrixCursor::getDataType() const {
+	return _impl->_dataType;
+}
+
 OmxMatrix::OmxMatrix(OmxDataType dataType, OmxIndex zones, const std::string& name, OmxCompressionLevel compressionLevel, const OmxFileOwnerData *ownerData)
-	: _impl{ new OmxMatrixImpl{ zones, dataType, name, compressionLevel, ownerData->_dataset, getDataTypeSize(dataType) } } {
+	: _impl{ new OmxMatrixImpl{ zones, dataType, name, compressionLevel, ownerData, getDataTypeSize(dataType) } } {
 
 }
 
@@ -116,13 +1416,15 @@ void OmxMatrix::writeRow(OmxIndex row, OmxIndex, void *rowBuffer, OmxDataType da
 	if (dataType != _impl->_dataType)
 		throw OmxMatrixException("Data type mismatch.");
 
-	_impl->writeRow(row, rowBuffer);
+	writeRow(row, rowBuffer);
 }
 
 void OmxMatrix::writeRow(OmxIndex row, void *rowBuffer) {
     if (row >= _impl->_zones)
         throw OmxMatrixException("Out of range.");
 
+    _impl->requireUnmapped();
+
     _impl->writeRow(row, rowBuffer);
 }
 
@@ -137,6 +1439,20 @@ void OmxMatrix::readRow(OmxIndex row, void *rowBuffer) {
 	if (row >= _impl->_zones)
 		throw std::out_of_range("Row index " + std::to_string(row) + " was out of the acceptable range.");
 
+	_impl->flushPendingRows();
+
+	if (_impl->_mapping.isMapped()) {
+		auto rowSize = _impl->getDataSizeOfRow();
+		std::memcpy(rowBuffer, _impl->_mapping.data() + row * rowSize, rowSize);
+		return;
+	}
+
+	if (_impl->useDirectChunkReads(_impl->_decompressionThreads)
+		&& _impl->getRowWindow(_impl->_decompressionThreads) * _impl->getDataSizeOfRow() <= MAX_ROW_WINDOW_SIZE) {
+		_impl->readRowDirect(row, rowBuffer);
+		return;
+	}
+
 	hsize_t dims[2],start[2];
 
 	dims[0] = 1;
@@ -162,20 +1478,241 @@ void OmxMatrix::readRow(OmxIndex row, void *rowBuffer) {
 	}
 }
 
+void OmxMatrix::readRowStrided(OmxIndex row, void *buffer, OmxIndex stride, bool isBackground) {
+	if (row >= _impl->_zones)
+		throw std::out_of_range("Row index " + std::to_string(row) + " was out of the acceptable range.");
+
+	if (isBackground) {
+		_impl->readRowH5(row, buffer, stride);
+		return;
+	}
+
+	_impl->flushPendingRows();
+
+	if (_impl->hasDecodedRow(row)) {
+		_impl->copyDecodedRow(row, buffer, stride);
+		return;
+	}
+
+	if (stride == 1) {
+		readRow(row, buffer);
+		return;
+	}
+
+	_impl->flushPendingRows();
+
+	// mapped and directly decoded rows are gathered first and then spread out
+	if (_impl->_mapping.isMapped() || _impl->useDirectChunkReads(_impl->_decompressionThreads)) {
+		auto size = _impl->_sizeOfDataType;
+		std::unique_ptr<uint8_t[]> rowBuffer(new uint8_t[_impl->getDataSizeOfRow()]);
+		readRow(row, rowBuffer.get());
+
+		for (OmxIndex col = 0; col < _impl->_zones; col++)
+			std::memcpy((uint8_t *)buffer + col * stride * size, rowBuffer.get() + col * size, size);
+
+		return;
+	}
+
+	_impl->readRowH5(row, buffer, stride);
+}
+
+OmxMatrixSummary OmxMatrix::summary() {
+	return summary(std::max<uint32_t>(std::thread::hardware_concurrency(), 1));
+}
+
+OmxMatrixSummary OmxMatrix::summary(uint32_t threadCount) {
+	return _impl->summarize(threadCount);
+}
+
+std::vector<double> OmxMatrix::rowSums() {
+	return summary().rowSums;
+}
+
+std::vector<double> OmxMatrix::columnSums() {
+	return summary().columnSums;
+}
+
+// total() and minMax() are answered from the stored statistics when they are current; those leave out
+// NaN values, which make the total NaN
+double OmxMatrix::total() {
+	if (_impl->hasStoredStats()) {
+		auto stats = _impl->getStoredStats();
+		return stats.nanCount > 0 ? std::numeric_limits<double>::quiet_NaN() : stats.sum;
+	}
+
+	return summary().total;
+}
+
+OmxMinMax OmxMatrix::minMax() {
+	if (_impl->hasStoredStats()) {
+		auto stats = _impl->getStoredStats();
+		return OmxMinMax{ stats.min, stats.max };
+	}
+
+	auto s = summary();
+	return OmxMinMax{ s.min, s.max };
+}
+
+bool OmxMatrix::hasStoredStats() const {
+	return _impl->hasStoredStats();
+}
+
+OmxMatrixStats OmxMatrix::getStoredStats() const {
+	return _impl->getStoredStats();
+}
+
+OmxMatrixCursor OmxMatrix::openCursor() {
+	if (_impl->_dataset < 0)
+		throw OmxMatrixException("Matrix '" + _impl->_name + "' is closed.");
+
+	_impl->flushPendingRows();
+
+	bool isDirect = _impl->_isChunked && _impl->_filters.isCompressed() && canCodeChunksDirectly(_impl->_filters)
+		&& _impl->_chunkDims[0] * _impl->getDataSizeOfRow() <= MAX_ROW_WINDOW_SIZE;
+	const uint8_t *mappedData = _impl->_mapping.isMapped() ? _impl->_mapping.data() : nullptr;
+
+	return OmxMatrixCursor(new OmxMatrixCursor::OmxMatrixCursorImpl(_impl->_dataset, _impl->_zones, _impl->_dataType,
+		_impl->_chunkDims, _impl->_filters, isDirect, mappedData, _impl->_readerCount));
+}
+
+bool OmxMatrix::hasSameChunkStorage(const OmxMatrix& other) const {
+	return _impl->hasSameChunkStorage(*other._impl);
+}
+
+bool OmxMatrix::isChunkRowStorageEqual(OmxMatrix& other, OmxIndex chunkRow) {
+	return _impl->isChunkRowStorageEqual(*other._impl, chunkRow);
+}
+
+void OmxMatrix::discard() {
+	_impl->discard();
+}
+
+OmxIndex OmxMatrix::fetchChunkRow(OmxIndex row) {
+	if (row >= _impl->_zones)
+		throw std::out_of_range("Row index " + std::to_string(row) + " was out of the acceptable range.");
+
+	return _impl->fetchChunkRow(row);
+}
+
+void OmxMatrix::decodeFetchedChunk(OmxIndex index) {
+	_impl->decodeFetchedChunk(index);
+}
+
+void OmxMatrix::finishChunkRow() {
+	_impl->finishChunkRow();
+}
+
+uint64_t OmxMatrix::getWriteGeneration() const {
+	return _impl->_writeGeneration;
+}
+
+void OmxMatrix::readBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, void *buffer) {
+	_impl->readBlock(rowStart, rowCount, colStart, colCount, buffer);
+}
+
+void OmxMatrix::writeBlock(OmxIndex rowStart, OmxIndex rowCount, OmxIndex colStart, OmxIndex colCount, const void *buffer) {
+	_impl->requireUnmapped();
+	_impl->_writeGeneration++;
+	_impl->writeBlock(rowStart, rowCount, colStart, colCount, buffer);
+}
+
+void OmxMatrix::readMatrix(void *buffer) {
+	_impl->transferMatrix(false, buffer, 1);
+}
+
+void OmxMatrix::readMatrix(void *buffer, uint32_t threadCount) {
+	_impl->transferMatrix(false, buffer, threadCount);
+}
+
+void OmxMatrix::writeMatrix(const void *buffer) {
+	_impl->requireUnmapped();
+	_impl->transferMatrix(true, const_cast<void *>(buffer), 1);
+}
+
+void OmxMatrix::writeMatrix(const void *buffer, uint32_t threadCount) {
+	_impl->requireUnmapped();
+	_impl->transferMatrix(true, const_cast<void *>(buffer), threadCount);
+}
+
+void OmxMatrix::readColumn(OmxIndex col, void *columnBuffer) {
+	_impl->readColumns(std::vector<OmxIndex>{ col }, columnBuffer);
+}
+
+void OmxMatrix::readColumns(const std::vector<OmxIndex>& cols, void *buffer) {
+	_impl->readColumns(cols, buffer);
+}
+
 void* OmxMatrix::createMatrixRowBuffer() const {
 	auto size = getDataTypeSize(_impl->_dataType) *  _impl->_zones;
 	return (void *)new uint8_t[size];
 }
 
+void* OmxMatrix::createMatrixBlockBuffer(OmxIndex rowCount, OmxIndex colCount) const {
+	auto size = getDataTypeSize(_impl->_dataType) * rowCount * colCount;
+	return (void *)new uint8_t[size];
+}
+
 void* OmxMatrix::createMatrixBuffer() const {
 	auto size = getDataTypeSize(_impl->_dataType) *  _impl->_zones * _impl->_zones;
 	return (void *)new uint8_t[size];
 }
 
+void OmxMatrix::setCompressionThreads(uint32_t threadCount) {
+	_impl->setCompressionThreads(threadCount);
+}
+
+uint32_t OmxMatrix::getCompressionThreads() const {
+	return _impl->_compressionThreads;
+}
+
+void OmxMatrix::setDecompressionThreads(uint32_t threadCount) {
+	_impl->setDecompressionThreads(threadCount);
+}
+
+uint32_t OmxMatrix::getDecompressionThreads() const {
+	return _impl->_decompressionThreads;
+}
+
+void OmxMatrix::setAccessHint(OmxAccessPattern accessPattern) {
+	_impl->setChunkCacheSettings(accessPattern, _impl->_requestedCacheSize);
+}
+
+OmxAccessPattern OmxMatrix::getAccessHint() const {
+	return _impl->_accessHint;
+}
+
+void OmxMatrix::setChunkCacheSize(size_t bytes) {
+	_impl->setChunkCacheSettings(_impl->_accessHint, bytes);
+}
+
+size_t OmxMatrix::getChunkCacheSize() const {
+	return _impl->getChunkCacheSize();
+}
+
+const void* OmxMatrix::mapReadOnly() {
+	return _impl->mapReadOnly();
+}
+
+void OmxMatrix::unmap() {
+	_impl->_mapping.unmap();
+}
+
+bool OmxMatrix::isMapped() const {
+	return _impl->_mapping.isMapped();
+}
+
+OmxChunkDims OmxMatrix::getChunkDims() const {
+	return OmxChunkDims{ _impl->_chunkDims[0], _impl->_chunkDims[1] };
+}
+
 OmxCompressionLevel OmxMatrix::getCompressionLevel() const {
 	return _impl->_compressionLevel;
 }
 
+OmxCompressionCodec OmxMatrix::getCompressionCodec() const {
+	return _impl->_compressionCodec;
+}
+
 OmxIndex OmxMatrix::getZones() const {
 	return _impl->_zones;
 }
@@ -193,7 +1730,8 @@ OmxAttributeCollection& OmxMatrix::attributes() const {
 }
 
 void OmxMatrix::close() {
-
+	_impl->flushPendingRows();
+	_impl->persistStats();
 }
 
 }
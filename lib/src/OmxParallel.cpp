@@ -0,0 +1,80 @@
+#include "OmxParallel.hpp"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include <hdf5.h>
+
+namespace omx {
+
+void parallelFor(OmxIndex taskCount, uint32_t threadCount, const std::function<void(OmxIndex)>& task) {
+	if (taskCount == 0)
+		return;
+
+	auto workers = (OmxIndex)std::max<uint32_t>(threadCount, 1);
+	workers = std::min(workers, taskCount);
+
+	if (workers == 1) {
+		for (OmxIndex i = 0; i < taskCount; i++)
+			task(i);
+
+		return;
+	}
+
+	std::atomic<OmxIndex> next(0);
+	std::atomic<bool> failed(false);
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	auto worker = [&]() {
+		OmxIndex i;
+		while (!failed && (i = next++) < taskCount) {
+			try {
+				task(i);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(errorMutex);
+				if (!error)
+					error = std::current_exception();
+
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (OmxIndex t = 1; t < workers; t++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& t : threads)
+		t.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+bool isH5ThreadSafe() {
+	hbool_t isThreadSafe = false;
+
+	if (H5is_library_threadsafe(&isThreadSafe) < 0)
+		return false;
+
+	return isThreadSafe > 0;
+}
+
+static std::mutex h5CallMutex;
+
+OmxH5CallLock::OmxH5CallLock() {
+	static const bool isThreadSafe = isH5ThreadSafe();
+
+	if (!isThreadSafe)
+		_lock = std::unique_lock<std::mutex>(h5CallMutex);
+}
+
+}
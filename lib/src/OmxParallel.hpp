@@ -0,0 +1,29 @@
+#ifndef OMXLIB_OMX_PARALLEL_HPP
+#define OMXLIB_OMX_PARALLEL_HPP
+
+#include "../include/OmxCommon.hpp"
+
+#include <functional>
+#include <mutex>
+
+namespace omx {
+
+// Runs task(0) .. task(taskCount - 1) on up to threadCount threads, the calling thread included.
+// The first exception thrown by a task is rethrown on the calling thread once all threads finish.
+void parallelFor(OmxIndex taskCount, uint32_t threadCount, const std::function<void(OmxIndex)>& task);
+
+// Whether HDF5 calls may be issued from more than one thread at a time.
+bool isH5ThreadSafe();
+
+// Held around HDF5 calls made from threads the library doesn't control, such as those of matrix cursors;
+// it serializes them when HDF5 isn't thread-safe and costs nothing when it is.
+class OmxH5CallLock {
+public:
+	OmxH5CallLock();
+
+private:
+	std::unique_lock<std::mutex> _lock;
+};
+
+}
+#endif
@@ -30,6 +30,15 @@ public:
 
 		if (_memspace >= 0)
 			H5Sclose(_memspace);
+
+		_attributes.reset(nullptr);
+
+		if (_dataset >= 0)
+			H5Dclose(_dataset);
+
+		_dataspace = -1;
+		_memspace = -1;
+		_dataset = -1;
 	}
 
 	void writeReference(const void *buffer)  {
@@ -0,0 +1,121 @@
+#include <OmxCommon.hpp>
+#include <OmxFile.hpp>
+#include <OmxMatrix.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// exit codes as diff uses them
+static const int EXIT_EQUAL = 0;
+static const int EXIT_DIFFERENT = 1;
+static const int EXIT_TROUBLE = 2;
+
+void usage() {
+	std::cout << "usage: omxdiff [options] file other_file [matrix ...]" << std::endl;
+	std::cout << "  -a <tolerance>  absolute tolerance (default 0)" << std::endl;
+	std::cout << "  -r <tolerance>  relative tolerance (default 0)" << std::endl;
+	std::cout << "  -n <count>      largest differences reported per matrix (default 10)" << std::endl;
+	std::cout << "  -t <threads>    threads (default: all cores)" << std::endl;
+	std::cout << "  -f              stop at the first mismatch" << std::endl;
+	std::cout << "Without matrix names all matrices of the same name are compared." << std::endl;
+}
+
+void printComparison(const omx::OmxMatrixComparison& comparison) {
+	std::cout << "------------------------------------------------------" << std::endl;
+	std::cout << "|  " << comparison.name << ": " << (comparison.mismatchCount == 0 ? "equal" : "DIFFERENT")
+		<< (comparison.isComplete ? "" : " (stopped at first mismatch)") << std::endl;
+	std::cout << "|    mismatches: " << comparison.mismatchCount << std::endl;
+	std::cout << "|    rmse: " << comparison.rmse << std::endl;
+	std::cout << "|    max difference: " << comparison.maxDifference << std::endl;
+	std::cout << "|    identical chunk rows skipped: " << comparison.identicalChunkRows << std::endl;
+
+	for (auto& difference : comparison.largestDifferences) {
+		std::cout << "|    (" << difference.row << ", " << difference.col << "): "
+			<< difference.value << " vs " << difference.otherValue << std::endl;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	omx::OmxCompareOptions options;
+	std::vector<std::string> arguments;
+
+	try {
+		for (int i = 1; i < argc; i++) {
+			std::string argument(argv[i]);
+			bool hasValue = i + 1 < argc;
+
+			if (argument == "-a" && hasValue)
+				options.absoluteTolerance = std::stod(argv[++i]);
+			else if (argument == "-r" && hasValue)
+				options.relativeTolerance = std::stod(argv[++i]);
+			else if (argument == "-n" && hasValue)
+				options.reportedDifferenceCount = std::stoul(argv[++i]);
+			else if (argument == "-t" && hasValue)
+				options.threadCount = (uint32_t)std::stoul(argv[++i]);
+			else if (argument == "-f")
+				options.stopAtFirstMismatch = true;
+			else if (!argument.empty() && argument[0] == '-') {
+				usage();
+				return EXIT_TROUBLE;
+			}
+			else
+				arguments.push_back(argument);
+		}
+	}
+	catch (std::exception&) {
+		usage();
+		return EXIT_TROUBLE;
+	}
+
+	if (arguments.size() < 2) {
+		usage();
+		return EXIT_TROUBLE;
+	}
+
+	try {
+		omx::OmxFile file(arguments[0]);
+		omx::OmxFile otherFile(arguments[1]);
+		file.openReadOnly();
+		otherFile.openReadOnly();
+
+		std::cout << "======================================================" << std::endl;
+		std::cout << "|  " << arguments[0] << " vs " << arguments[1] << std::endl;
+
+		bool isEqual = true;
+
+		if (arguments.size() > 2) {
+			for (size_t i = 2; i < arguments.size(); i++) {
+				auto comparison = file.compareMatrix(arguments[i], otherFile, arguments[i], options);
+				printComparison(comparison);
+
+				isEqual = isEqual && comparison.mismatchCount == 0;
+				if (!isEqual && options.stopAtFirstMismatch)
+					break;
+			}
+		}
+		else {
+			auto comparison = file.compare(otherFile, options);
+			for (auto& matrix : comparison.matrices)
+				printComparison(matrix);
+
+			std::cout << "------------------------------------------------------" << std::endl;
+			for (auto& name : comparison.onlyInFile)
+				std::cout << "|  only in " << arguments[0] << ": " << name << std::endl;
+			for (auto& name : comparison.onlyInOther)
+				std::cout << "|  only in " << arguments[1] << ": " << name << std::endl;
+
+			isEqual = comparison.isEqual();
+		}
+
+		std::cout << "======================================================" << std::endl;
+		std::cout << (isEqual ? "Files are equal." : "Files differ.") << std::endl;
+
+		return isEqual ? EXIT_EQUAL : EXIT_DIFFERENT;
+	}
+	catch (std::exception& ex) {
+		std::cout << "exception: " << ex.what() << std::endl;
+		return EXIT_TROUBLE;
+	}
+}
@@ -0,0 +1,275 @@
+#include <OmxCommon.hpp>
+#include <OmxChunkPolicy.hpp>
+#include <OmxComparison.hpp>
+#include <OmxExpression.hpp>
+#include <OmxFile.hpp>
+#include <OmxMatrix.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include <cmath>
+
+// Regression checks of the library, run by ctest. Every check prints a line on failure; the exit code
+// is the number of failed checks.
+
+static int failureCount = 0;
+
+static void check(bool condition, const std::string& what) {
+	if (!condition) {
+		std::cout << "** FAILED: " << what << std::endl;
+		failureCount++;
+	}
+}
+
+static std::vector<omx::OmxDouble> getTestValues(omx::OmxIndex zones, omx::OmxIndex seed) {
+	std::vector<omx::OmxDouble> values(zones * zones);
+	for (omx::OmxIndex i = 0; i < zones * zones; i++)
+		values[i] = (omx::OmxDouble)((i * 7919 + seed) % 1009) * 0.25;
+
+	return values;
+}
+
+static std::string getCodecName(omx::OmxCompressionCodec codec) {
+	switch (codec) {
+	case omx::OmxCompressionCodec::Deflate:			return "Deflate";
+	case omx::OmxCompressionCodec::ShuffleDeflate:	return "ShuffleDeflate";
+	case omx::OmxCompressionCodec::ShuffleLZ4:		return "ShuffleLZ4";
+	case omx::OmxCompressionCodec::ShuffleZstd:		return "ShuffleZstd";
+	}
+
+	return "unknown";
+}
+
+// writes a matrix whole and another row by row for every codec and chunk policy, and reads both back
+// whole, by row, by block and by column, before and after reopening the file
+static void testRoundTrips() {
+	const omx::OmxIndex zones = 301;
+	auto values = getTestValues(zones, 0);
+
+	struct Layout {
+		std::string name;
+		omx::OmxChunkPolicy policy;
+	};
+
+	std::vector<Layout> layouts = {
+		{ "default", omx::OmxChunkPolicy::defaultPolicy() },
+		{ "row strip", omx::OmxChunkPolicy::rowStrip() },
+		{ "square tile", omx::OmxChunkPolicy::squareTile(64) },
+		{ "explicit", omx::OmxChunkPolicy::explicitDims(16, 100) }
+	};
+
+	std::vector<omx::OmxCompressionCodec> codecs = {
+		omx::OmxCompressionCodec::Deflate, omx::OmxCompressionCodec::ShuffleDeflate,
+		omx::OmxCompressionCodec::ShuffleLZ4, omx::OmxCompressionCodec::ShuffleZstd
+	};
+
+	std::vector<std::string> names;
+
+	{
+		omx::OmxFile file("omxtest_roundtrip.omx");
+		file.openWithTruncate(zones);
+
+		for (auto codec : codecs) {
+			if (!omx::isCompressionCodecAvailable(codec))
+				continue;
+
+			for (auto& layout : layouts) {
+				auto name = getCodecName(codec) + " " + layout.name;
+				auto& whole = file.addMatrix(name + " whole", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1, codec, layout.policy);
+				whole.writeMatrix(values.data());
+
+				auto& rows = file.addMatrix(name + " rows", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1, codec, layout.policy);
+				for (omx::OmxIndex row = 0; row < zones; row++)
+					rows.writeRow(row, values.data() + row * zones);
+
+				names.push_back(name + " whole");
+				names.push_back(name + " rows");
+			}
+		}
+
+		auto& contiguous = file.addMatrix("contiguous", omx::OmxDataType::Double, omx::OmxCompressionLevel::NoCompression, omx::OmxChunkPolicy::contiguous());
+		contiguous.writeMatrix(values.data());
+		names.push_back("contiguous");
+
+		file.close();
+	}
+
+	for (auto readOnly : { false, true }) {
+		omx::OmxFile file("omxtest_roundtrip.omx");
+		if (readOnly)
+			file.openReadOnly();
+		else
+			file.open();
+
+		for (auto& name : names) {
+			auto& matrix = file.getMatrix(name);
+			auto what = "round trip of '" + name + "'" + (readOnly ? " read only" : "");
+
+			std::vector<omx::OmxDouble> read(zones * zones);
+			matrix.readMatrix(read.data());
+			check(read == values, what + ": readMatrix");
+
+			std::vector<omx::OmxDouble> row(zones);
+			matrix.readRow(zones / 2, row.data());
+			check(std::equal(row.begin(), row.end(), values.begin() + zones / 2 * zones), what + ": readRow");
+
+			std::vector<omx::OmxDouble> block(20 * 30);
+			matrix.readBlock(60, 20, 90, 30, block.data());
+			bool isBlockEqual = true;
+			for (omx::OmxIndex r = 0; r < 20; r++) {
+				for (omx::OmxIndex c = 0; c < 30; c++)
+					isBlockEqual = isBlockEqual && block[r * 30 + c] == values[(60 + r) * zones + 90 + c];
+			}
+			check(isBlockEqual, what + ": readBlock");
+
+			std::vector<omx::OmxDouble> column(zones);
+			matrix.readColumn(zones - 1, column.data());
+			bool isColumnEqual = true;
+			for (omx::OmxIndex r = 0; r < zones; r++)
+				isColumnEqual = isColumnEqual && column[r] == values[r * zones + zones - 1];
+			check(isColumnEqual, what + ": readColumn");
+		}
+	}
+}
+
+// removes matrices with rows still collected for a chunk row, and adds one of the same name again
+static void testRemoveAfterWrites() {
+	const omx::OmxIndex zones = 150;
+	auto values = getTestValues(zones, 1);
+	auto otherValues = getTestValues(zones, 2);
+
+	{
+		omx::OmxFile file("omxtest_remove.omx");
+		file.openWithTruncate(zones);
+
+		auto& partial = file.addMatrix("partial", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1, omx::OmxChunkPolicy::rowStrip());
+		for (omx::OmxIndex row = 0; row < 3; row++)
+			partial.writeRow(row, values.data() + row * zones);
+		file.removeMatrix("partial");
+		check(!file.matrixNameExists("partial"), "removeMatrix: the matrix is gone");
+
+		auto& whole = file.addMatrix("whole", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1);
+		whole.writeMatrix(values.data());
+		file.removeMatrix("whole");
+
+		auto& again = file.addMatrix("partial", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1, omx::OmxChunkPolicy::rowStrip());
+		again.writeMatrix(otherValues.data());
+
+		file.close();
+	}
+
+	omx::OmxFile file("omxtest_remove.omx");
+	file.openReadOnly();
+
+	check(!file.matrixNameExists("whole"), "removeMatrix: the matrix stays gone after reopening");
+	check(file.matrixNameExists("partial"), "removeMatrix: the matrix added again exists");
+
+	std::vector<omx::OmxDouble> read(zones * zones);
+	file.getMatrix("partial").readMatrix(read.data());
+	check(read == otherValues, "removeMatrix: the matrix added again holds its own values");
+}
+
+// evaluates expressions that read the matrix they write, into a floating point and an integer matrix
+static void testEvaluateInPlace() {
+	const omx::OmxIndex zones = 257;
+	auto values = getTestValues(zones, 3);
+
+	omx::OmxFile file("omxtest_evaluate.omx");
+	file.openWithTruncate(zones);
+
+	file.addMatrix("double", omx::OmxDataType::Double, omx::OmxCompressionLevel::Level_1).writeMatrix(values.data());
+
+	std::vector<omx::OmxInt32> intValues(zones * zones);
+	for (omx::OmxIndex i = 0; i < zones * zones; i++)
+		intValues[i] = (omx::OmxInt32)values[i];
+	file.addMatrix("int", omx::OmxDataType::Int32, omx::OmxCompressionLevel::Level_1).writeMatrix(intValues.data());
+
+	for (auto threadCount : { 1u, 4u }) {
+		auto what = "evaluate in place on " + std::to_string(threadCount) + " threads";
+
+		file.evaluate("double", omx::OmxExpression::matrix("double") * 2.0 + 1.0, threadCount);
+		file.evaluate("int", omx::OmxExpression::matrix("int") - omx::OmxExpression::matrix("double"), threadCount);
+
+		std::vector<omx::OmxDouble> read(zones * zones);
+		file.getMatrix("double").readMatrix(read.data());
+		std::vector<omx::OmxInt32> intRead(zones * zones);
+		file.getMatrix("int").readMatrix(intRead.data());
+
+		bool isEqual = true;
+		bool isIntEqual = true;
+		for (omx::OmxIndex i = 0; i < zones * zones; i++) {
+			values[i] = values[i] * 2.0 + 1.0;
+			intValues[i] = (omx::OmxInt32)(intValues[i] - values[i]);
+			isEqual = isEqual && read[i] == values[i];
+			isIntEqual = isIntEqual && intRead[i] == intValues[i];
+		}
+
+		check(isEqual, what + ": Double result");
+		check(isIntEqual, what + ": Int32 result");
+	}
+}
+
+// compares matrices holding infinities and NaN
+static void testCompareNonFinite() {
+	const omx::OmxIndex zones = 40;
+	const auto infinity = std::numeric_limits<double>::infinity();
+	const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+	auto values = getTestValues(zones, 4);
+	values[0] = infinity;
+	values[1] = -infinity;
+	values[2] = nan;
+
+	auto swappedInfinities = values;
+	swappedInfinities[0] = -infinity;
+	swappedInfinities[1] = infinity;
+
+	auto numberForNan = values;
+	numberForNan[2] = 1.0;
+
+	auto numberForInfinity = values;
+	numberForInfinity[0] = 1e300;
+
+	omx::OmxFile file("omxtest_compare.omx");
+	file.openWithTruncate(zones);
+	file.addMatrix("values", omx::OmxDataType::Double).writeMatrix(values.data());
+	file.addMatrix("same", omx::OmxDataType::Double).writeMatrix(values.data());
+	file.addMatrix("swapped infinities", omx::OmxDataType::Double).writeMatrix(swappedInfinities.data());
+	file.addMatrix("number for NaN", omx::OmxDataType::Double).writeMatrix(numberForNan.data());
+	file.addMatrix("number for infinity", omx::OmxDataType::Double).writeMatrix(numberForInfinity.data());
+
+	omx::OmxCompareOptions options;
+	options.relativeTolerance = 1e-6;
+
+	auto same = file.compareMatrix("values", file, "same", options);
+	check(same.mismatchCount == 0, "compare: equal infinities and NaN match");
+
+	auto swapped = file.compareMatrix("values", file, "swapped infinities", options);
+	check(swapped.mismatchCount == 2, "compare: infinities of opposite sign don't match");
+	check(std::isinf(swapped.maxDifference), "compare: infinities of opposite sign differ infinitely");
+
+	auto nanMismatch = file.compareMatrix("values", file, "number for NaN", options);
+	check(nanMismatch.mismatchCount == 1, "compare: NaN doesn't match a number");
+
+	auto infinityMismatch = file.compareMatrix("values", file, "number for infinity", options);
+	check(infinityMismatch.mismatchCount == 1, "compare: infinity doesn't match a large number within relative tolerance");
+}
+
+int main() {
+	try {
+		testRoundTrips();
+		testRemoveAfterWrites();
+		testEvaluateInPlace();
+		testCompareNonFinite();
+	}
+	catch (std::exception& e) {
+		std::cout << "!! Exception !! : " << e.what() << std::endl;
+		failureCount++;
+	}
+
+	std::cout << (failureCount == 0 ? "All checks passed." : std::to_string(failureCount) + " checks failed.") << std::endl;
+	return failureCount;
+}